@@ -7,5 +7,6 @@
 
 void gamma_correct(const uint8_t* img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t* result);
 float gamma_pow(float, float);
+typedef void (*seq_kernel)(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result); // signature shared by all versions working on interleaved RGB bytes
 
 #endif
\ No newline at end of file
@@ -2,23 +2,23 @@
 
 static float *packed_compute_greyscale(const float *, const float *, const float *, size_t, size_t, float, float, float);
 
-void gamma_correct_V2(float *red, float *green, float *blue, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result)
+_Bool gamma_correct_V2(const float *red, const float *green, const float *blue, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result)
 {
+    uint64_t span_start = trace_begin();
     float *greyscale_value_of_pixels = packed_compute_greyscale(red, green, blue, width, height, a, b, c);//this function uses simd to compute greyscale converison
-    if(!greyscale_value_of_pixels){//check if the allocation in packed_compute_greyscale succeeded
-        free(red);
-        free(green);
-        free(blue);
-        free(result);
-        fprintf(stderr, "Cannot allocate space for grey scale values. Program terminated.\n");
-        exit(EXIT_FAILURE);
+    trace_end("greyscale", span_start);
+    if(!greyscale_value_of_pixels){//check if the allocation in packed_compute_greyscale succeeded, the buffers belong to the caller, result may even point into the input of in-place conversion
+        return false;
     }
+    span_start = trace_begin();
     size_t number_of_pixels = width * height;
     for (size_t i = 0; i < number_of_pixels; ++i)//do gamma correction with pow function from pixel to pixel
     {
         result[i] = roundf(pow(greyscale_value_of_pixels[i], gamma) * 255);//round the result to the nearest integer
     }
+    trace_end("gamma", span_start);
     free(greyscale_value_of_pixels);
+    return true;
 }
 
 static float *packed_compute_greyscale(const float *red, const float *green, const float *blue, size_t width, size_t height, float a, float b, float c)
@@ -4,8 +4,9 @@
 #include <immintrin.h>
 #include <math.h>
 #include <stdio.h>
+#include "trace.h"
 
 #ifndef V2_H
 #define V2_H
-void gamma_correct_V2(float *red, float *green, float *blue, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result);
+_Bool gamma_correct_V2(const float *red, const float *green, const float *blue, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result); // returns false if the grey scale values can't be allocated, no buffer is freed then
 #endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "V3.h"
+#define CACHE_SIZE 1024         // number of entries in the direct mapped cache, has to be a power of two
+#define CACHE_VALID 0x1000000u // set in every key which holds a computed value, so that the zeroed cache contains no valid entry
+#define CACHE_MIN_PIXELS CACHE_SIZE // smaller pieces, e.g. the tile rows of option frames, are computed without the cache, clearing its 8 KiB would cost more than it saves
+
+struct cache_entry // one slot of the direct mapped RGB -> output cache
+{
+    uint32_t key; // 24 bit RGB value | CACHE_VALID
+    uint8_t value;
+};
+
+static size_t run_length(const uint8_t *, size_t);
+static uint8_t lookup(struct cache_entry *, const uint8_t *, float, float, float, float); // cache may be NULL, then the value is computed
+static uint8_t compute(const uint8_t *, float, float, float, float);
+
+void gamma_correct_V3(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result)
+{
+    float sum_coeffs = a + b + c;
+    float a_div_sum_coeffs = a / sum_coeffs;
+    float b_div_sum_coeffs = b / sum_coeffs;
+    float c_div_sum_coeffs = c / sum_coeffs;
+    // after the computation above, the sum of a_div_sum_coeffs, b_div_sum_coeffs, and c_div_sum_coeffs will be 1
+    struct cache_entry cache_entries[CACHE_SIZE]; // the cache only lives for one call, as the coefficients and gamma may change between calls
+    size_t num_pixel = width * height;
+    struct cache_entry *cache = NULL;
+    if (num_pixel >= CACHE_MIN_PIXELS)
+    {
+        memset(cache_entries, 0, sizeof(cache_entries));
+        cache = cache_entries;
+    }
+    size_t i = 0;
+    while (i < num_pixel)
+    {
+        const uint8_t *pixel = img + 3 * i;
+        size_t run = 1;                                                                 // number of pixels equal to pixel i, including pixel i itself
+        if (i + 1 < num_pixel && pixel[0] == pixel[3] && pixel[1] == pixel[4] && pixel[2] == pixel[5]) // only start the SIMD run detection if the next pixel is equal, so photos don't pay for it
+        {
+            run = run_length(pixel, num_pixel - i);
+        }
+        uint8_t value = lookup(cache, pixel, a_div_sum_coeffs, b_div_sum_coeffs, c_div_sum_coeffs, gamma); // compute the value only once for the whole run
+        if (run == 1)
+        {
+            result[i] = value;
+        }
+        else
+        {
+            memset(result + i, value, run); // synthetic images have long runs, fill them like memset instead of pixel by pixel
+        }
+        i += run;
+    }
+}
+
+static size_t run_length(const uint8_t *pixel, size_t remaining_pixels) // pixels are equal iff every byte equals the byte three positions later, so compare the raw bytes with SSE2
+{
+    size_t remaining_bytes = remaining_pixels * 3;
+    size_t x = 0; // number of bytes verified to satisfy pixel[x] == pixel[x + 3]
+    while (x + 19 <= remaining_bytes) // both 16 byte loads must stay inside the image
+    {
+        __m128i current = _mm_loadu_si128((const __m128i *)(pixel + x));
+        __m128i next = _mm_loadu_si128((const __m128i *)(pixel + x + 3));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(current, next)) != 0xFFFF) // mismatch somewhere in these 16 bytes, locate it below
+        {
+            break;
+        }
+        x += 16;
+    }
+    while (x + 3 < remaining_bytes && pixel[x] == pixel[x + 3]) // handle the tail and locate the exact end of the run
+    {
+        ++x;
+    }
+    return (x + 3) / 3; // bytes 0 .. x + 2 repeat with period 3, so (x + 3) / 3 complete pixels are equal
+}
+
+static uint8_t lookup(struct cache_entry *cache, const uint8_t *pixel, float a_div_sum_coeffs, float b_div_sum_coeffs, float c_div_sum_coeffs, float gamma)
+{
+    if (!cache)
+    {
+        return compute(pixel, a_div_sum_coeffs, b_div_sum_coeffs, c_div_sum_coeffs, gamma);
+    }
+    uint32_t key = (pixel[0] << 16 | pixel[1] << 8 | pixel[2]) | CACHE_VALID;
+    struct cache_entry *entry = cache + ((key * 2654435761u) >> 22) % CACHE_SIZE; // multiplicative hashing, so that similar colors don't collide
+    if (entry->key != key) // miss
+    {
+        entry->key = key;
+        entry->value = compute(pixel, a_div_sum_coeffs, b_div_sum_coeffs, c_div_sum_coeffs, gamma);
+    }
+    return entry->value;
+}
+
+static uint8_t compute(const uint8_t *pixel, float a_div_sum_coeffs, float b_div_sum_coeffs, float c_div_sum_coeffs, float gamma) // exactly like V0
+{
+    float Q_x_y = a_div_sum_coeffs * pixel[0] + b_div_sum_coeffs * pixel[1] + c_div_sum_coeffs * pixel[2];
+    return roundf(gamma_pow(Q_x_y, gamma));
+}
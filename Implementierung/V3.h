@@ -0,0 +1,11 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+#include <math.h>
+#include "V0.h"
+
+#ifndef V3_H
+#define V3_H
+void gamma_correct_V3(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result);
+#endif
@@ -0,0 +1,204 @@
+#include "V4.h"
+#include "parallelio.h"
+#define LUT_SIZE (1 << 24) // one output byte for every 24 bit RGB value
+#define CACHE_MAGIC "GCLUT24"  // first bytes of a cached table, files of other programs are never mapped
+#define CACHE_FORMAT 1         // increase whenever the layout or the computation of the cached table changes
+
+struct cache_header // precedes the table in a cache file, all fields are checked before the table is trusted
+{
+    char magic[8];
+    uint32_t format;
+    uint32_t table_size; // always LUT_SIZE
+    uint32_t key[4];     // bit patterns of a, b, c and gamma, the file name alone may be stale or copied
+    uint8_t reserved[32]; // pads the header to 64 bytes
+};
+
+struct build_range // the table is built in parallel, every thread computes the entries of some red values
+{
+    uint8_t *table;
+    uint32_t first_red;
+    uint32_t last_red; // exclusive
+    float a_div_sum_coeffs, b_div_sum_coeffs, c_div_sum_coeffs, gamma;
+    _Bool in_thread; // false if the range is computed by the calling thread, then it must not be joined
+};
+
+static const char *cache_directory = NULL; // where tables are persisted, NULL means no persistence
+static size_t build_threads = 1;            // number of threads used to build a table
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER; // with option T several threads may ask for the table at the same time
+static const uint8_t *table = NULL;         // the current table, kept for the lifetime of the program
+static uint32_t table_key[4];               // bit patterns of a, b, c and gamma of the current table
+
+static const uint8_t *get_table(float, float, float, float);
+static uint8_t *build_table(float, float, float, float);
+static void *build_range(void *);
+static const uint8_t *map_cached_table(const char *, const uint32_t *);
+static void store_table(const char *, const uint32_t *, const uint8_t *);
+
+void lut24_configure(const char *cache_dir, size_t number_of_threads)
+{
+    cache_directory = cache_dir;
+    build_threads = number_of_threads;
+}
+
+void lut24_prepare(float a, float b, float c, float gamma)
+{
+    get_table(a, b, c, gamma);
+}
+
+void gamma_correct_V4(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result)
+{
+    const uint8_t *lut = get_table(a, b, c, gamma); // built or mapped only once, later calls and benchmark repetitions reuse it
+    size_t num_pixel = width * height;
+    for (size_t i = 0; i < num_pixel; ++i) // every pixel is a single lookup, no arithmetic
+    {
+        result[i] = lut[img[3 * i] << 16 | img[3 * i + 1] << 8 | img[3 * i + 2]];
+    }
+}
+
+static const uint8_t *get_table(float a, float b, float c, float gamma)
+{
+    uint32_t key[4];
+    memcpy(&key[0], &a, 4); // key by the exact bit patterns, so a cached table is never reused for slightly different parameters
+    memcpy(&key[1], &b, 4);
+    memcpy(&key[2], &c, 4);
+    memcpy(&key[3], &gamma, 4);
+    pthread_mutex_lock(&table_lock);
+    if (table && memcmp(key, table_key, sizeof(key)) == 0)
+    {
+        pthread_mutex_unlock(&table_lock);
+        return table;
+    }
+    // tables of previous parameters are not released, the program uses one parameter set in practice
+    uint64_t span_start = trace_begin();
+    char path[4096];
+    const uint8_t *lut = NULL;
+    if (cache_directory)
+    {
+        snprintf(path, sizeof(path), "%s/lut24-%08x-%08x-%08x-%08x.bin", cache_directory, key[0], key[1], key[2], key[3]);
+        lut = map_cached_table(path, key);
+    }
+    if (!lut)
+    {
+        uint8_t *built = build_table(a, b, c, gamma);
+        if (cache_directory)
+        {
+            store_table(path, key, built);
+        }
+        lut = built;
+    }
+    memcpy(table_key, key, sizeof(key));
+    table = lut;
+    pthread_mutex_unlock(&table_lock);
+    trace_end("lookup table", span_start);
+    return lut;
+}
+
+static uint8_t *build_table(float a, float b, float c, float gamma)
+{
+    uint8_t *lut = malloc(LUT_SIZE);
+    size_t number_of_threads = build_threads > 256 ? 256 : build_threads; // every thread computes at least one red value
+    pthread_t *threads = malloc(number_of_threads * sizeof(pthread_t));
+    struct build_range *ranges = malloc(number_of_threads * sizeof(struct build_range));
+    if (!lut || !threads || !ranges)
+    {
+        free(lut);
+        free(threads);
+        free(ranges);
+        fprintf(stderr, "Cannot allocate space for the lookup table. Program terminated.\n");
+        exit(EXIT_FAILURE);
+    }
+    float sum_coeffs = a + b + c; // same coefficients as V0, so that the table gives exactly the result of V0
+    uint32_t first_red = 0;
+    for (size_t i = 0; i < number_of_threads; ++i)
+    {
+        uint32_t reds = 256 / number_of_threads + (i < 256 % number_of_threads);
+        ranges[i] = (struct build_range){lut, first_red, first_red + reds, a / sum_coeffs, b / sum_coeffs, c / sum_coeffs, gamma, true};
+        first_red += reds;
+        if (pthread_create(&threads[i], NULL, build_range, &ranges[i]) != 0) // if no thread can be created, this range is computed by the calling thread
+        {
+            ranges[i].in_thread = false;
+            build_range(&ranges[i]);
+        }
+    }
+    for (size_t i = 0; i < number_of_threads; ++i)
+    {
+        if (ranges[i].in_thread)
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    free(threads);
+    free(ranges);
+    return lut;
+}
+
+static void *build_range(void *arg)
+{
+    struct build_range *range = arg;
+    for (uint32_t red = range->first_red; red < range->last_red; ++red)
+    {
+        for (uint32_t green = 0; green < 256; ++green)
+        {
+            uint8_t *row = range->table + (red << 16 | green << 8);
+            for (uint32_t blue = 0; blue < 256; ++blue)
+            {
+                float Q_x_y = range->a_div_sum_coeffs * red + range->b_div_sum_coeffs * green + range->c_div_sum_coeffs * blue; // same expression as in V0
+                row[blue] = roundf(gamma_pow(Q_x_y, range->gamma));
+            }
+        }
+    }
+    return NULL;
+}
+
+static const uint8_t *map_cached_table(const char *path, const uint32_t *key) // returns NULL if there is no usable table in the cache
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    struct stat file_status;
+    if (fstat(fd, &file_status) != 0 || file_status.st_size != sizeof(struct cache_header) + LUT_SIZE) // an incomplete table is rebuilt
+    {
+        close(fd);
+        return NULL;
+    }
+    void *file = mmap(NULL, sizeof(struct cache_header) + LUT_SIZE, PROT_READ, MAP_SHARED, fd, 0); // shared mapping, so that concurrent runs share the page cache
+    close(fd);
+    if (file == MAP_FAILED)
+    {
+        return NULL;
+    }
+    const struct cache_header *header = file;
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 || header->format != CACHE_FORMAT || header->table_size != LUT_SIZE || memcmp(header->key, key, sizeof(header->key)) != 0) // a stale or foreign file is rebuilt and replaced
+    {
+        munmap(file, sizeof(struct cache_header) + LUT_SIZE);
+        return NULL;
+    }
+    return (const uint8_t *)file + sizeof(struct cache_header);
+}
+
+static void store_table(const char *path, const uint32_t *key, const uint8_t *lut) // failures are only reported, the table in memory is still usable
+{
+    char tmp_path[4096 + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid()); // write to a temporary file and rename it, so other runs never map a partial table
+    if (mkdir(cache_directory, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Cannot create the lookup table cache directory, the table is not persisted.\n");
+        return;
+    }
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Cannot create the lookup table cache file, the table is not persisted.\n");
+        return;
+    }
+    struct cache_header header = {CACHE_MAGIC, CACHE_FORMAT, LUT_SIZE, {key[0], key[1], key[2], key[3]}, {0}};
+    _Bool written = pwrite_all(fd, (const uint8_t *)&header, sizeof(header), 0) && pwrite_all(fd, lut, LUT_SIZE, sizeof(header));
+    if (close(fd) != 0 || !written || rename(tmp_path, path) != 0)
+    {
+        unlink(tmp_path);
+        fprintf(stderr, "Failed to write the lookup table cache file, the table is not persisted.\n");
+    }
+}
+
@@ -0,0 +1,21 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "V0.h"
+#include "trace.h"
+
+#ifndef V4_H
+#define V4_H
+void gamma_correct_V4(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result);
+void lut24_configure(const char *cache_dir, size_t number_of_threads); // cache_dir may be NULL, then the table is not persisted
+void lut24_prepare(float a, float b, float c, float gamma);            // build or map the table now, so that the following calls of gamma_correct_V4 only look up
+#endif
@@ -0,0 +1,106 @@
+#include "approx.h"
+#define WEIGHT_BITS 22 // fraction bits of the fixed point weights, 255 times their sum still fits into 32 bits
+#define MAX_TABLE_BITS 8 // fraction bits of the table index, 8 gives 65282 entries, finer tables would not fit into L2 any more
+
+struct approx_table // the greyscale value is computed in fixed point and quantised to 1 / 2^bits, the table holds the gamma corrected value of every quantisation step
+{
+    int bits;
+    uint32_t weight[3];
+    uint8_t value[(255 << MAX_TABLE_BITS) + 2]; // the rounded weights may sum up to 1.5 / 2^WEIGHT_BITS more than one, so the index may exceed 255 * 2^bits by one
+};
+
+static struct approx_table table = {-1, {0}, {0}}; // built once by approx_configure, read only afterwards, so the threads of option T share it
+
+static int build_table(uint8_t *, int, double, float); // fill the table for the given quantisation and return the largest difference to V0 over all greyscale values, derived from the monotony of the gamma correction
+
+int approx_configure(float max_error, float a, float b, float c, float gamma)
+{
+    float sum_coeffs = a + b + c;
+    float coeffs[3] = {a / sum_coeffs, b / sum_coeffs, c / sum_coeffs}; // the same weights as V0
+    uint32_t weight[3];
+    double weight_error = 0; // largest difference between the fixed point and the float greyscale value
+    for (int i = 0; i < 3; ++i)
+    {
+        weight[i] = lround(coeffs[i] * (1 << WEIGHT_BITS));
+        weight_error += fabs(weight[i] - coeffs[i] * (1 << WEIGHT_BITS)) * 255 / (1 << WEIGHT_BITS);
+    }
+    weight_error += 255 * 6 * 0x1p-24; // V0 rounds three products and two sums in float, the bounds below are rounded to float once
+    table.bits = -1; // the candidates are built in the table itself, it is only valid again once one of them meets the budget
+    for (int bits = 0; bits <= MAX_TABLE_BITS; ++bits) // coarser tables are smaller and stay in L1, so the first table within the budget is the cheapest
+    {
+        int error = build_table(table.value, bits, weight_error, gamma);
+        if (error <= max_error)
+        {
+            table.bits = bits;
+            for (int i = 0; i < 3; ++i)
+            {
+                table.weight[i] = weight[i];
+            }
+            return error;
+        }
+    }
+    return -1;
+}
+
+size_t approx_table_size(void)
+{
+    return table.bits < 0 ? 0 : (255u << table.bits) + 2;
+}
+
+void gamma_correct_approx(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result)
+{
+    (void)a, (void)b, (void)c, (void)gamma; // the table has been built for them in approx_configure
+    const uint8_t *value = table.value;
+    uint32_t red = table.weight[0], green = table.weight[1], blue = table.weight[2];
+    int shift = WEIGHT_BITS - table.bits;
+    uint32_t half = 1u << (shift - 1); // round to the nearest quantisation step
+    size_t num_pixel = width * height;
+    for (size_t i = 0; i < num_pixel; ++i) // three integer multiplications and one lookup instead of pow
+    {
+        result[i] = value[(red * img[3 * i] + green * img[3 * i + 1] + blue * img[3 * i + 2] + half) >> shift];
+    }
+}
+
+void approx_report(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, const uint8_t *result)
+{
+    size_t num_pixel = width * height;
+    uint8_t *exact = malloc(num_pixel + 1);
+    if (!exact)
+    {
+        fprintf(stderr, "Not enough memory to compare with version 0.\n");
+        return;
+    }
+    uint64_t span_start = trace_begin();
+    gamma_correct(img, width, height, a, b, c, gamma, exact);
+    int max_error = 0;
+    uint64_t sum_error = 0;
+    for (size_t i = 0; i < num_pixel; ++i)
+    {
+        int error = abs(result[i] - exact[i]);
+        max_error = error > max_error ? error : max_error;
+        sum_error += error;
+    }
+    trace_end("compare with V0", span_start);
+    printf("Achieved error against version 0: max %d LSB, mean %lf LSB.\n", max_error, num_pixel ? (double)sum_error / num_pixel : 0);
+    free(exact);
+}
+
+static int build_table(uint8_t *value, int bits, double weight_error, float gamma)
+{
+    double step = 1.0 / (1 << bits);
+    int error = 0;
+    for (size_t index = 0; index <= (255u << bits) + 1; ++index) // the index of every greyscale value in [index - 1/2, index + 1/2) steps, widened by the error of the weights
+    {
+        double low = (index - 0.5) * step - weight_error;
+        double high = (index + 0.5) * step + weight_error;
+        low = low < 0 ? 0 : low > 255 ? 255 : low; // greyscale values lie in [0, 255], the cells at both ends reach beyond
+        high = high < 0 ? 0 : high > 255 ? 255 : high;
+        int low_value = roundf(gamma_pow(low, gamma)); // V0 is monotone in the greyscale value, so its results in the interval lie between these two
+        int high_value = roundf(gamma_pow(high, gamma));
+        int middle = (low_value + high_value + 1) / 2; // the middle halves the error where the gamma correction is steep
+        value[index] = middle;
+        error = middle - low_value > error ? middle - low_value : error;
+        error = high_value - middle > error ? high_value - middle : error;
+    }
+    return error;
+}
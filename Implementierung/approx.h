@@ -0,0 +1,14 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "V0.h"
+#include "trace.h"
+
+#ifndef APPROX_H
+#define APPROX_H
+int approx_configure(float max_error, float a, float b, float c, float gamma);                                                       // choose the coarsest table whose proven error is at most max_error LSB, returns the proven error or -1 if no table meets the budget
+size_t approx_table_size(void);                                                                                                     // number of entries of the chosen table
+void gamma_correct_approx(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result); // fixed point greyscale conversion and one lookup in the chosen table, approx_configure has to be called before
+void approx_report(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, const uint8_t *result);  // run V0 on img and print the max and mean difference of result
+#endif
@@ -0,0 +1,167 @@
+#include "frames.h"
+
+static _Bool reset_state(struct frame_state *, size_t, size_t);                                          // allocate the output and the flags for a new size, all tiles are dirty
+static _Bool convert_tile_row(const struct frame_state *, size_t, seq_kernel, float, float, float, float); // convert the dirty tiles of one row of tiles
+
+size_t frame_update(struct frame_state *state, uint8_t *img, size_t width, size_t height, seq_kernel kernel, float a, float b, float c, float gamma)
+{
+    uint64_t span_start = trace_begin();
+    size_t dirty_tiles = 0;
+    if (!state->input || state->width != width || state->height != height) // nothing to compare with
+    {
+        if (!reset_state(state, width, height))
+        {
+            free(img);
+            return 0;
+        }
+        dirty_tiles = state->tiles_per_row * state->tile_rows;
+    }
+    else
+    {
+        memset(state->dirty, 0, state->tiles_per_row * state->tile_rows);
+        for (size_t y = 0; y < height; ++y) // row by row, so both frames are read sequentially, a tile is not compared again once it is dirty
+        {
+            uint8_t *dirty = state->dirty + y / TILE_ROWS * state->tiles_per_row;
+            const uint8_t *row = img + y * width * 3;
+            const uint8_t *previous_row = state->input + y * width * 3;
+            for (size_t tile = 0; tile < state->tiles_per_row; ++tile)
+            {
+                size_t x = tile * TILE_WIDTH;
+                size_t tile_width = width - x < TILE_WIDTH ? width - x : TILE_WIDTH;
+                if (!dirty[tile] && memcmp(row + x * 3, previous_row + x * 3, tile_width * 3) != 0)
+                {
+                    dirty[tile] = 1;
+                    ++dirty_tiles;
+                }
+            }
+        }
+    }
+    free(state->input);
+    state->input = img;
+    trace_end("compare frames", span_start);
+    span_start = trace_begin();
+    for (size_t tile_row = 0; tile_row < state->tile_rows; ++tile_row)
+    {
+        if (!convert_tile_row(state, tile_row, kernel, a, b, c, gamma))
+        {
+            frame_state_free(state);
+            return 0;
+        }
+    }
+    trace_end("convert dirty tiles", span_start);
+    return dirty_tiles;
+}
+
+_Bool frame_patch_output(const struct frame_state *state, const char *output_file)
+{
+    uint64_t span_start = trace_begin();
+    char header[64];
+    off_t header_length = snprintf(header, sizeof(header), "P5\n%lu\n%lu\n255\n", state->width, state->height);
+    int fd = open(output_file, O_WRONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    _Bool success = true;
+    for (size_t y = 0; y < state->height && success; ++y)
+    {
+        const uint8_t *dirty = state->dirty + y / TILE_ROWS * state->tiles_per_row;
+        for (size_t tile = 0; tile < state->tiles_per_row && success; ++tile)
+        {
+            size_t last = tile;
+            while (last < state->tiles_per_row && dirty[last]) // neighbouring dirty tiles are written at once
+            {
+                ++last;
+            }
+            if (last > tile)
+            {
+                size_t x = tile * TILE_WIDTH;
+                size_t end = last * TILE_WIDTH < state->width ? last * TILE_WIDTH : state->width;
+                success = pwrite_all(fd, state->output + y * state->width + x, end - x, header_length + y * state->width + x);
+                tile = last;
+            }
+        }
+    }
+    success = close(fd) == 0 && success; // delayed write errors are reported by close
+    trace_end("patch output", span_start);
+    return success;
+}
+
+void frame_state_free(struct frame_state *state)
+{
+    free(state->input);
+    free(state->output);
+    free(state->dirty);
+    free(state->scratch);
+    *state = (struct frame_state){0};
+}
+
+static _Bool reset_state(struct frame_state *state, size_t width, size_t height)
+{
+    frame_state_free(state);
+    state->width = width;
+    state->height = height;
+    state->tiles_per_row = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+    state->tile_rows = (height + TILE_ROWS - 1) / TILE_ROWS;
+    state->output = malloc(width * height + 1); // + 1 so that malloc never gets 0
+    state->dirty = malloc(state->tiles_per_row * state->tile_rows + 1);
+    state->scratch = malloc(width * TILE_ROWS * 4 + 1); // 3 input bytes and 1 output byte per pixel of a band
+    if (!state->output || !state->dirty || !state->scratch)
+    {
+        frame_state_free(state);
+        return false;
+    }
+    memset(state->dirty, 1, state->tiles_per_row * state->tile_rows);
+    return true;
+}
+
+static _Bool convert_tile_row(const struct frame_state *state, size_t tile_row, seq_kernel kernel, float a, float b, float c, float gamma)
+{
+    const uint8_t *dirty = state->dirty + tile_row * state->tiles_per_row;
+    size_t first_row = tile_row * TILE_ROWS;
+    size_t rows = state->height - first_row < TILE_ROWS ? state->height - first_row : TILE_ROWS;
+    size_t width = state->width;
+    if (memchr(dirty, 0, state->tiles_per_row) == NULL) // the whole width changed, the rows are contiguous and converted with one call
+    {
+        return transform_rows(kernel, state->input + first_row * width * 3, width, rows, a, b, c, gamma, state->output + first_row * width);
+    }
+    for (size_t tile = 0; tile < state->tiles_per_row; ++tile) // otherwise every run of dirty tiles is converted on its own
+    {
+        size_t last = tile;
+        while (last < state->tiles_per_row && dirty[last])
+        {
+            ++last;
+        }
+        if (last == tile)
+        {
+            continue;
+        }
+        size_t x = tile * TILE_WIDTH;
+        size_t run_width = (last * TILE_WIDTH < width ? last * TILE_WIDTH : width) - x;
+        if (kernel) // the byte kernels allocate nothing, they run directly on the row segments
+        {
+            for (size_t y = first_row; y < first_row + rows; ++y)
+            {
+                kernel(state->input + (y * width + x) * 3, run_width, 1, a, b, c, gamma, state->output + y * width + x);
+            }
+        }
+        else // V2 allocates its planes per call, so the rows of the run are gathered and converted at once
+        {
+            uint8_t *gathered_output = state->scratch + width * TILE_ROWS * 3;
+            for (size_t y = 0; y < rows; ++y)
+            {
+                memcpy(state->scratch + y * run_width * 3, state->input + ((first_row + y) * width + x) * 3, run_width * 3);
+            }
+            if (!transform_rows(NULL, state->scratch, run_width, rows, a, b, c, gamma, gathered_output))
+            {
+                return false;
+            }
+            for (size_t y = 0; y < rows; ++y)
+            {
+                memcpy(state->output + (first_row + y) * width + x, gathered_output + y * run_width, run_width);
+            }
+        }
+        tile = last;
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "V0.h"
+#include "parallelio.h"
+#include "trace.h"
+
+#ifndef FRAMES_H
+#define FRAMES_H
+#define TILE_WIDTH 64 // pixels, a row of a tile is 192 input bytes, so memcmp compares whole cache lines
+#define TILE_ROWS 16
+
+struct frame_state // the previous frame of a sequence, its input is compared with the next frame to find the tiles which have to be converted again
+{
+    size_t width, height;
+    size_t tiles_per_row, tile_rows;
+    uint8_t *input;  // previous input, owned by the state
+    uint8_t *output; // output of all frames so far, only the changed tiles are overwritten
+    uint8_t *dirty;  // one flag per tile, set by frame_update
+    uint8_t *scratch; // the rows of a run of dirty tiles gathered for V2, followed by their output, so a run is converted with one call
+};
+
+size_t frame_update(struct frame_state *state, uint8_t *img, size_t width, size_t height, seq_kernel kernel, float a, float b, float c, float gamma); // take over img, convert only the tiles which differ from the previous frame and return their number, all tiles are converted for the first frame or if the size changes, returns 0 and frees img if allocation fails
+_Bool frame_patch_output(const struct frame_state *state, const char *output_file);                                                                // pwrite only the changed tiles into the output file of the previous frame
+void frame_state_free(struct frame_state *state);
+#endif
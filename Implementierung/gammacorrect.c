@@ -1,11 +1,16 @@
 #include "gammacorrect.h"
 
-#define VERSION_NUMBER 3 // we have three versions
+#define VERSION_NUMBER 5 // we have five versions
+#define IN_PLACE_BLOCK_PIXELS 65536 // V2 converts blocks of about this many pixels in place, its float buffers only exist for one block
 
 static _Bool v_set = false;           // is V set?
 static int version = 0;               // version number, default is zero, value checked in found_option_V
+static _Bool version_auto = false;    // is V set to auto? then version, threads and block rows are taken from the wisdom file
 static _Bool b_set = false;           // is B set?
 static int benchmark_number = 1000;   // benchmark number, default is 1000, value checked in found_option_B
+static _Bool t_set = false;           // is T set?
+static int number_of_threads = 1;     // number of threads for parallel I/O, value checked in found_option_T
+static size_t block_rows = 0;         // rows every thread reads, converts and writes at once, only set by the autotuner, 0 means all rows of the thread
 static char *input_file_name = NULL;  // input file name, value checked in parse_options
 static _Bool o_set = false;           // is o set?
 static char *output_file_name = NULL; // output file name, value checked in check_value
@@ -16,20 +21,56 @@ static float c = 0.114;               // default c is 0.114
 static _Bool gamma_set = false;       // is gamma set?
 static float _gamma = 1;              // default gamma is 1
 static const char *program_path;      // stores the path of the program
+static _Bool trace_set = false;       // is trace set?
+static char *lut_cache_dir = NULL;    // directory for persisted lookup tables of V4, NULL if not set
+static _Bool tune_set = false;        // is tune set?
+static char *wisdom_file_name = NULL; // wisdom file written by tune and read by V auto, default is gammacorrect.wisdom
+static _Bool linearize_set = false;   // is linearize set?
+static _Bool numa_set = false;        // is numa set?
+static _Bool pyramid_set = false;     // is pyramid set?
+static _Bool frames_set = false;      // is frames set?
+static char **frame_file_names = NULL; // with option frames all input files in the given order, the first one is also input_file_name
+static int number_of_frames = 0;
+static _Bool in_place_set = false;    // is in-place set?
+static _Bool max_error_set = false;   // is max-error set?
+static float max_error = 0;           // largest allowed difference to version 0 in LSB, value checked in found_option_max_error
 // long options' table
 static const struct option long_options[] = {
     {"coeffs", required_argument, 0, 256},
     {"gamma", required_argument, 0, 257},
+    {"trace", required_argument, 0, 258},
+    {"lut-cache", required_argument, 0, 259},
+    {"tune", no_argument, 0, 260},
+    {"wisdom", required_argument, 0, 261},
+    {"linearize", no_argument, 0, 262},
+    {"numa", no_argument, 0, 263},
+    {"pyramid", no_argument, 0, 264},
+    {"frames", no_argument, 0, 265},
+    {"in-place", no_argument, 0, 266},
+    {"max-error", required_argument, 0, 267},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}};
 // function signatures
 static void parse_options(int, char **);                                                             // getopt_long() to parse options
 static void found_option_V(void);                                                                    // behaviour if found option '-V'
 static void found_option_B(void);                                                                    // behaviour if found option '-B'
+static void found_option_T(void);                                                                    // behaviour if found option '-T'
 static void found_option_o(void);                                                                    // behaviour if found option '-o'
 static void found_option_h(void);                                                                    // behaviour if found option '-h' or '--help'
 static void found_option_coeffs(void);                                                               // behaviour if found option '--coeffs'
 static void found_option_gamma(void);                                                                // behaviour if found option '--gamma'
+static void found_option_trace(void);                                                                // behaviour if found option '--trace'
+static void found_option_lut_cache(void);                                                            // behaviour if found option '--lut-cache'
+static void found_option_tune(void);                                                                 // behaviour if found option '--tune'
+static void found_option_wisdom(void);                                                               // behaviour if found option '--wisdom'
+static void found_option_linearize(void);                                                            // behaviour if found option '--linearize'
+static void found_option_numa(void);                                                                 // behaviour if found option '--numa'
+static void found_option_pyramid(void);                                                              // behaviour if found option '--pyramid'
+static void found_option_frames(void);                                                               // behaviour if found option '--frames'
+static void found_option_in_place(void);                                                             // behaviour if found option '--in-place'
+static void found_option_max_error(void);                                                            // behaviour if found option '--max-error'
+static seq_kernel choose_approximation(void);                                                        // the cheapest kernel whose proven error is within max_error, version 0 if there is none
+static void choose_tuning(void);                                                                     // run the autotuner or consult the wisdom file, if tune or V auto is set
 static void print_help(void);                                                                        // print help
 static void print_usage(void);                                                                       // print usage
 static void exit_failure_with_errmessage(const char *);                                              // note that error message must end with newline, this function will log the error to stderr and print usage, and then exit with failure
@@ -38,32 +79,54 @@ static float parseFloatFromStr(char *, const char *);
 static int parseIntFromStr(char *, const char *);                                                    // parse a String into int, handle errors
 static void allocate_for_ppm_pgm_seq(size_t *, size_t *, uint8_t **, uint8_t **);                    // allocate space for input file and output file, which used for sequential implementation, V0 & V1
 static void allocate_for_ppm_pgm_simd(size_t *, size_t *, float **, float **, float **, uint8_t **); // allocate space for input file and output file, which used for SIMD implementation, V2
-static void gamma_correct_seq(_Bool);                                                                // this function takes _Bool, if set true, then gamma_correct will be used, if set false, gamma_correct_V1 will be used
+static void gamma_correct_seq(seq_kernel);                                                           // this function takes the kernel of a version working on interleaved RGB bytes, V0, V1, V3 or V4
 static void gamma_correct_simd(void);                                                                // this function takes no parameter, and gamma_correct_V2 will be used
+static void gamma_correct_parallel(seq_kernel);                                                      // read, transform and write row aligned slices of the image in parallel, the kernel is passed to every thread, NULL for V2
+static void gamma_correct_in_place(seq_kernel);                                                      // write the output into the consumed prefix of the input buffer, NULL for V2
+static void gamma_correct_frames(seq_kernel);                                                        // convert a sequence of frames, only the tiles which changed since the previous frame are converted and written again
+static _Bool output_has_frame_number(void);                                                          // does the output file name contain '%d' and no other conversion?
 static _Bool save_output_to_outputfile(size_t, size_t, uint8_t *, FILE *);                           // save the output into the given output file
+static _Bool save_pyramid(struct pyramid *);                                                         // save every level of the pyramid into its own file next to the output file
 static void free_for_seq(uint8_t *, uint8_t *);                                                      // if gamma_correct_seq ends or an error occured in function body, then release memory for input and output
 static void free_for_simd(float *, float *, float *, uint8_t *);                                     // if gamma_correct_simd ends or an error occured in function body, then release memory for output and input of every color
 
 int main(int argc, char **argv)
 {
     program_path = argv[0];                                                                                                                                                        // save program path as global, will be used in print_help and print_usage
+    uint64_t parse_start = trace_clock();                                                                                                                                          // tracing is enabled while parsing, so the clock is read unconditionally here
     parse_options(argc, argv);                                                                                                                                                     // getopt_long
     check_values();                                                                                                                                                                // check if all values are acceptable
+    trace_end("parse options", parse_start);
+    lut24_configure(lut_cache_dir, t_set ? (size_t)number_of_threads : (size_t)sysconf(_SC_NPROCESSORS_ONLN)); // the lookup table of V4 is built with all cores unless the user limits the threads
+    choose_tuning();
     printf("version is %d\nbenchmark_number is %d\ngamma is %f\ninput file name is %s\na is %f\nb is %f\nc is %f\n", version, benchmark_number, _gamma, input_file_name, a, b, c); // for testing
-    switch (version)
-    {
-    case 0:
-        gamma_correct_seq(true);
-        break;
-    case 1:
-        gamma_correct_seq(false);
-        break;
-    case 2:
+    seq_kernel kernel = linearize_set ? gamma_correct_linear : kernel_of_version(version); // linear light replaces the kernel of the version
+    if (max_error_set) // so does the cheapest kernel within the error budget
+    {
+        kernel = choose_approximation();
+    }
+    if (in_place_set) // V2 is run on blocks of the byte input
+    {
+        gamma_correct_in_place(kernel);
+        return 0;
+    }
+    if (frames_set) // the tiles are converted one after another
+    {
+        gamma_correct_frames(kernel);
+        return 0;
+    }
+    if (t_set) // parallel I/O handles all versions
+    {
+        gamma_correct_parallel(kernel);
+        return 0;
+    }
+    if (kernel)
+    {
+        gamma_correct_seq(kernel);
+    }
+    else // V2 works on float planes of the whole image
+    {
         gamma_correct_simd();
-        break;
-    default:
-        fprintf(stderr, "There is a bug with version number, please contact developer.\n");
-        exit(EXIT_FAILURE);
     }
     return 0;
 }
@@ -71,7 +134,7 @@ int main(int argc, char **argv)
 static void parse_options(int argc, char **argv)
 {
     int opt = 0;
-    while ((opt = getopt_long(argc, argv, "V:B::o:h", long_options, NULL)) != -1)
+    while ((opt = getopt_long(argc, argv, "V:B::T:o:h", long_options, NULL)) != -1)
     {
         switch (opt)
         {
@@ -81,6 +144,9 @@ static void parse_options(int argc, char **argv)
         case 'B':
             found_option_B();
             break;
+        case 'T':
+            found_option_T();
+            break;
         case 'o':
             found_option_o();
             break;
@@ -93,6 +159,36 @@ static void parse_options(int argc, char **argv)
         case 257: //--gamma
             found_option_gamma();
             break;
+        case 258: //--trace
+            found_option_trace();
+            break;
+        case 259: //--lut-cache
+            found_option_lut_cache();
+            break;
+        case 260: //--tune
+            found_option_tune();
+            break;
+        case 261: //--wisdom
+            found_option_wisdom();
+            break;
+        case 262: //--linearize
+            found_option_linearize();
+            break;
+        case 263: //--numa
+            found_option_numa();
+            break;
+        case 264: //--pyramid
+            found_option_pyramid();
+            break;
+        case 265: //--frames
+            found_option_frames();
+            break;
+        case 266: //--in-place
+            found_option_in_place();
+            break;
+        case 267: //--max-error
+            found_option_max_error();
+            break;
         default: // option argument missing or unknown option
             exit_failure_with_errmessage("You give a wrong option or you forget to give argument to an option.\n");
         }
@@ -105,10 +201,16 @@ static void parse_options(int argc, char **argv)
     {
         input_file_name = argv[optind];
     }
+    else if (frames_set) // a sequence of frames
+    {
+        input_file_name = argv[optind];
+    }
     else // to many input files
     {
         exit_failure_with_errmessage("More than one input file is given.\n");
     }
+    frame_file_names = argv + optind;
+    number_of_frames = argc - optind;
 }
 
 static void found_option_V(void)
@@ -117,10 +219,16 @@ static void found_option_V(void)
     {
         exit_failure_with_errmessage("Option 'V' is already set, please don't set it twice.\n");
     }
+    if (strcmp(optarg, "auto") == 0) // the version is chosen in choose_tuning
+    {
+        version_auto = true;
+        v_set = true;
+        return;
+    }
     version = parseIntFromStr(optarg, "Argument of option 'V' parsing fails.\n"); // parse int from a string, if failed, report the error message
     if (version < 0 || version > VERSION_NUMBER - 1)                              // version number not allowed
     {
-        exit_failure_with_errmessage("The given version number is not provided, provided versions are 0, 1, 2\n");
+        exit_failure_with_errmessage("The given version number is not provided, provided versions are 0, 1, 2, 3, 4\n");
     }
     v_set = true;
 }
@@ -142,6 +250,20 @@ static void found_option_B(void)
     b_set = true;
 }
 
+static void found_option_T(void)
+{
+    if (t_set)
+    {
+        exit_failure_with_errmessage("Option 'T' is already set, please don't set it twice.\n");
+    }
+    number_of_threads = parseIntFromStr(optarg, "Argument of option 'T' parsing fails.\n"); // parse int from string, if failed, report the error message
+    if (number_of_threads < 1)
+    {
+        exit_failure_with_errmessage("The number of threads has to be at least 1.\n");
+    }
+    t_set = true;
+}
+
 static void found_option_o(void)
 {
     if (o_set)
@@ -204,6 +326,102 @@ static void found_option_gamma(void)
     gamma_set = true;
 }
 
+static void found_option_trace(void)
+{
+    if (trace_set)
+    {
+        exit_failure_with_errmessage("Option 'trace' is already set, please don't set it twice.\n");
+    }
+    trace_enable(optarg); // the trace file is written when the program exits
+    trace_set = true;
+}
+
+static void found_option_lut_cache(void)
+{
+    if (lut_cache_dir)
+    {
+        exit_failure_with_errmessage("Option 'lut-cache' is already set, please don't set it twice.\n");
+    }
+    lut_cache_dir = optarg;
+}
+
+static void found_option_tune(void)
+{
+    if (tune_set)
+    {
+        exit_failure_with_errmessage("Option 'tune' is already set, please don't set it twice.\n");
+    }
+    tune_set = true;
+}
+
+static void found_option_wisdom(void)
+{
+    if (wisdom_file_name)
+    {
+        exit_failure_with_errmessage("Option 'wisdom' is already set, please don't set it twice.\n");
+    }
+    wisdom_file_name = optarg;
+}
+
+static void found_option_linearize(void)
+{
+    if (linearize_set)
+    {
+        exit_failure_with_errmessage("Option 'linearize' is already set, please don't set it twice.\n");
+    }
+    linearize_set = true;
+}
+
+static void found_option_numa(void)
+{
+    if (numa_set)
+    {
+        exit_failure_with_errmessage("Option 'numa' is already set, please don't set it twice.\n");
+    }
+    numa_set = true;
+}
+
+static void found_option_pyramid(void)
+{
+    if (pyramid_set)
+    {
+        exit_failure_with_errmessage("Option 'pyramid' is already set, please don't set it twice.\n");
+    }
+    pyramid_set = true;
+}
+
+static void found_option_frames(void)
+{
+    if (frames_set)
+    {
+        exit_failure_with_errmessage("Option 'frames' is already set, please don't set it twice.\n");
+    }
+    frames_set = true;
+}
+
+static void found_option_in_place(void)
+{
+    if (in_place_set)
+    {
+        exit_failure_with_errmessage("Option 'in-place' is already set, please don't set it twice.\n");
+    }
+    in_place_set = true;
+}
+
+static void found_option_max_error(void)
+{
+    if (max_error_set)
+    {
+        exit_failure_with_errmessage("Option 'max-error' is already set, please don't set it twice.\n");
+    }
+    max_error = parseFloatFromStr(optarg, "Argument of option 'max-error' parsing fails.\n");
+    if (max_error < 0)
+    {
+        exit_failure_with_errmessage("The maximal error can not be negative.\n");
+    }
+    max_error_set = true;
+}
+
 static void print_help(void)
 {
     printf(help_msg, program_path);
@@ -275,6 +493,44 @@ static void check_values(void)
     {
         exit_failure_with_errmessage("Only non negative gamma accepted.\n");
     }
+    if (tune_set && v_set && !version_auto) // the autotuner chooses the version itself
+    {
+        exit_failure_with_errmessage("Option 'tune' can only be combined with '-V auto'.\n");
+    }
+    if ((tune_set || version_auto) && t_set) // the autotuner chooses the number of threads itself
+    {
+        exit_failure_with_errmessage("Option 'T' can not be combined with option 'tune' or '-V auto'.\n");
+    }
+    if (numa_set && !t_set && !tune_set && !version_auto) // only the threads of parallel I/O can be placed on nodes
+    {
+        exit_failure_with_errmessage("Option 'numa' requires option 'T'.\n");
+    }
+    if (frames_set && (b_set || t_set || pyramid_set)) // the frames are converted one after another by the main thread
+    {
+        exit_failure_with_errmessage("Option 'frames' can not be combined with option 'B', 'T' or 'pyramid'.\n");
+    }
+    if (in_place_set && (b_set || t_set || tune_set || pyramid_set || frames_set)) // the input is overwritten, so it can't be converted again, and the output is the only buffer
+    {
+        exit_failure_with_errmessage("Option 'in-place' can not be combined with option 'B', 'T', 'tune', 'pyramid' or 'frames'.\n");
+    }
+    if (frames_set && !output_has_frame_number() && strchr(output_file_name, '%')) // the output file name is used as format string
+    {
+        exit_failure_with_errmessage("The output file name may only contain '%d' for the frame number.\n");
+    }
+    if (max_error_set && (v_set || tune_set || linearize_set)) // the error budget chooses the kernel itself
+    {
+        exit_failure_with_errmessage("Option 'max-error' can not be combined with option 'V', 'tune' or 'linearize'.\n");
+    }
+    if (linearize_set && (v_set || tune_set)) // linear light has its own kernel
+    {
+        exit_failure_with_errmessage("Option 'linearize' can not be combined with option 'V' or 'tune'.\n");
+    }
+    if (linearize_set && !coeffs_set) // the default coefficients are luma weights for gamma encoded values, for linear light the luminance weights of sRGB are used
+    {
+        a = 0.2126;
+        b = 0.7152;
+        c = 0.0722;
+    }
 }
 
 static void allocate_for_ppm_pgm_seq(size_t *width, size_t *height, uint8_t **img, uint8_t **result)
@@ -303,19 +559,25 @@ static void allocate_for_ppm_pgm_simd(size_t *width, size_t *height, float **red
     }
 }
 
-static void gamma_correct_seq(_Bool isDefault)
+static void gamma_correct_seq(seq_kernel kernel)
 {
     size_t width, height;
     uint8_t *input = NULL;
     uint8_t *output = NULL;
     allocate_for_ppm_pgm_seq(&width, &height, &input, &output); // read ppm file and allocate space for input and output data, read metadata
-    if (isDefault)                                              // the default version should be used?
+    struct pyramid pyramid = {0};
+    if (pyramid_set && !pyramid_alloc(&pyramid, width, height))
     {
-        gamma_correct(input, width, height, a, b, c, _gamma, output);
+        free_for_seq(input, output);
+        fprintf(stderr, "%s", "memory allocation failed\n");
+        exit(EXIT_FAILURE);
     }
-    else
+    uint64_t span_start = trace_begin();
+    pyramid_set ? gamma_correct_pyramid(kernel, input, width, height, a, b, c, _gamma, output, &pyramid) : kernel(input, width, height, a, b, c, _gamma, output); // the pyramid is reduced stripe by stripe in the same pass
+    trace_end("greyscale and gamma", span_start);
+    if (kernel == gamma_correct_approx) // make the price of the approximation visible
     {
-        gamma_correct_V1(input, width, height, a, b, c, _gamma, output);
+        approx_report(input, width, height, a, b, c, _gamma, output);
     }
     FILE *fd = fopen(output_file_name, "w"); // open output file
     if (!fd)                                 // check if fopen succeeded
@@ -324,9 +586,10 @@ static void gamma_correct_seq(_Bool isDefault)
         fprintf(stderr, "Cannot open output file. Program terminated.\n");
         exit(EXIT_FAILURE);
     }
-    if (!save_output_to_outputfile(width, height, output, fd)) // check if write into output file succeeded
+    if (!save_output_to_outputfile(width, height, output, fd) || (pyramid_set && !save_pyramid(&pyramid))) // check if write into output file succeeded
     {
         free_for_seq(input, output);
+        pyramid_free(&pyramid);
         fclose(fd);
         fprintf(stderr, "Failed to write into output file. Program terminated.\n");
         exit(EXIT_FAILURE);
@@ -337,14 +600,9 @@ static void gamma_correct_seq(_Bool isDefault)
         clock_gettime(CLOCK_MONOTONIC, &start);
         for (int i = 0; i < benchmark_number; ++i)
         {
-            if (isDefault) // choose the version from V0 and V1
-            {
-                gamma_correct(input, width, height, a, b, c, _gamma, output);
-            }
-            else
-            {
-                gamma_correct_V1(input, width, height, a, b, c, _gamma, output);
-            }
+            uint64_t span_start = trace_begin();
+            pyramid_set ? gamma_correct_pyramid(kernel, input, width, height, a, b, c, _gamma, output, &pyramid) : kernel(input, width, height, a, b, c, _gamma, output);
+            trace_end("greyscale and gamma", span_start);
         }
         struct timespec end;
         clock_gettime(CLOCK_MONOTONIC, &end);
@@ -352,6 +610,7 @@ static void gamma_correct_seq(_Bool isDefault)
         printf("This execution takes %lfs.\n", time);
     }
     free_for_seq(input, output);
+    pyramid_free(&pyramid);
     fclose(fd); // free all
 }
 
@@ -363,7 +622,21 @@ static void gamma_correct_simd(void)
     float *blue_in_pixels = NULL;
     uint8_t *output = NULL;
     allocate_for_ppm_pgm_simd(&width, &height, &red_in_pixels, &green_in_pixels, &blue_in_pixels, &output); // allocate space for R, G and B and output, read metadata from input ppm
-    gamma_correct_V2(red_in_pixels, green_in_pixels, blue_in_pixels, width, height, a, b, c, _gamma, output);
+    struct pyramid pyramid = {0};
+    if (pyramid_set && !pyramid_alloc(&pyramid, width, height))
+    {
+        free_for_simd(red_in_pixels, green_in_pixels, blue_in_pixels, output);
+        fprintf(stderr, "%s", "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    _Bool success = pyramid_set ? gamma_correct_pyramid_V2(red_in_pixels, green_in_pixels, blue_in_pixels, width, height, a, b, c, _gamma, output, &pyramid) : gamma_correct_V2(red_in_pixels, green_in_pixels, blue_in_pixels, width, height, a, b, c, _gamma, output); // the pyramid is reduced stripe by stripe in the same pass
+    if (!success)
+    {
+        free_for_simd(red_in_pixels, green_in_pixels, blue_in_pixels, output);
+        pyramid_free(&pyramid);
+        fprintf(stderr, "Cannot allocate space for grey scale values. Program terminated.\n");
+        exit(EXIT_FAILURE);
+    }
     FILE *fd = fopen(output_file_name, "w"); // open output file
     if (!fd)                                 // check if fopen succeeded
     {
@@ -371,9 +644,10 @@ static void gamma_correct_simd(void)
         fprintf(stderr, "Cannot open output file. Program terminated.\n");
         exit(EXIT_FAILURE);
     }
-    if (!save_output_to_outputfile(width, height, output, fd)) // check if writing into output file succeeded
+    if (!save_output_to_outputfile(width, height, output, fd) || (pyramid_set && !save_pyramid(&pyramid))) // check if writing into output file succeeded
     {
         free_for_simd(red_in_pixels, green_in_pixels, blue_in_pixels, output);
+        pyramid_free(&pyramid);
         fclose(fd);
         fprintf(stderr, "Failed to write into output file. Program terminated.\n");
         exit(EXIT_FAILURE);
@@ -384,7 +658,15 @@ static void gamma_correct_simd(void)
         clock_gettime(CLOCK_MONOTONIC, &start);
         for (int i = 0; i < benchmark_number; ++i)
         {
-            gamma_correct_V2(red_in_pixels, green_in_pixels, blue_in_pixels, width, height, a, b, c, _gamma, output);
+            success = pyramid_set ? gamma_correct_pyramid_V2(red_in_pixels, green_in_pixels, blue_in_pixels, width, height, a, b, c, _gamma, output, &pyramid) : gamma_correct_V2(red_in_pixels, green_in_pixels, blue_in_pixels, width, height, a, b, c, _gamma, output);
+            if (!success)
+            {
+                free_for_simd(red_in_pixels, green_in_pixels, blue_in_pixels, output);
+                pyramid_free(&pyramid);
+                fclose(fd);
+                fprintf(stderr, "Cannot allocate space for grey scale values. Program terminated.\n");
+                exit(EXIT_FAILURE);
+            }
         }
         struct timespec end;
         clock_gettime(CLOCK_MONOTONIC, &end);
@@ -392,19 +674,207 @@ static void gamma_correct_simd(void)
         printf("This execution takes %lfs.\n", time);
     }
     free_for_simd(red_in_pixels, green_in_pixels, blue_in_pixels, output);
+    pyramid_free(&pyramid);
     fclose(fd); // free all
 }
 
+static void choose_tuning(void)
+{
+    if (!tune_set && !version_auto)
+    {
+        return;
+    }
+    if (!wisdom_file_name)
+    {
+        wisdom_file_name = "gammacorrect.wisdom";
+    }
+    size_t width, height;
+    char magic;
+    readppm_header_length(input_file_name, &width, &height, &magic); // the wisdom depends on the image shape
+    struct tuning tuning;
+    _Bool tuned = true;
+    if (tune_set)
+    {
+        tuning = tune(input_file_name, a, b, c, _gamma, lut_cache_dir != NULL);
+        if (!wisdom_store(wisdom_file_name, width, height, _gamma, lut_cache_dir != NULL, tuning)) // the image is still converted with the tuned parameters
+        {
+            fprintf(stderr, "Failed to write into wisdom file.\n");
+        }
+    }
+    else if (!(tuned = wisdom_lookup(wisdom_file_name, width, height, _gamma, lut_cache_dir != NULL, &tuning)))
+    {
+        printf("No wisdom for this host, image size and use of option lut-cache, version 0 is used. Run with option 'tune' first.\n");
+    }
+    if (tuned) // the fastest parameters are used by this run, whether they were just measured or looked up
+    {
+        version = tuning.version;
+        number_of_threads = tuning.number_of_threads;
+        block_rows = tuning.block_rows;
+        t_set = magic == '6' && (number_of_threads > 1 || block_rows > 0); // use parallel I/O if the tuner picked more than one thread or blocks, ASCII input is read by one thread
+    }
+    if (numa_set && !t_set) // only the threads of parallel I/O can be placed on nodes
+    {
+        fprintf(stderr, "Warning: option 'numa' is ignored, because the image is converted by one thread.\n");
+    }
+}
+
+static seq_kernel choose_approximation(void)
+{
+    uint64_t span_start = trace_begin();
+    int error = approx_configure(max_error, a, b, c, _gamma);
+    trace_end("choose approximation", span_start);
+    if (error < 0)
+    {
+        printf("No approximation is within %f LSB, version 0 is used.\n", max_error);
+        return gamma_correct;
+    }
+    printf("Approximation with a table of %lu entries, proven error at most %d LSB.\n", approx_table_size(), error);
+    return gamma_correct_approx;
+}
+
+static void gamma_correct_parallel(seq_kernel kernel)
+{ // the output file is written by the worker threads, so there is nothing to release here
+    struct numa_bandwidth bandwidth = {0}; // summed over the benchmark runs and printed once at the end
+    struct numa_bandwidth *numa = numa_set ? &bandwidth : NULL;
+    gamma_correct_parallel_io(input_file_name, output_file_name, kernel, number_of_threads, block_rows, numa, pyramid_set, a, b, c, _gamma);
+    if (b_set) // user sets option B for benchmarking? Here the whole pipeline including I/O is measured
+    {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < benchmark_number; ++i)
+        {
+            gamma_correct_parallel_io(input_file_name, output_file_name, kernel, number_of_threads, block_rows, numa, pyramid_set, a, b, c, _gamma);
+        }
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+        printf("This execution takes %lfs.\n", time);
+    }
+    if (numa)
+    {
+        numa_report(numa);
+    }
+}
+
+static void gamma_correct_in_place(seq_kernel kernel)
+{
+    size_t width, height;
+    uint8_t *input = readppm_for_seq(input_file_name, &width, &height); // the only buffer, pixel i of the output is written to byte i, which is behind the three bytes of pixel i
+    uint64_t span_start = trace_begin();
+    size_t rows_per_block = kernel ? height : IN_PLACE_BLOCK_PIXELS / (width ? width : 1) + 1; // transform_rows deinterleaves a whole block before V2 writes its output, so a block may overwrite its own input
+    for (size_t row = 0; row < height; row += rows_per_block)
+    {
+        size_t rows = height - row < rows_per_block ? height - row : rows_per_block;
+        if (!transform_rows(kernel, input + row * width * 3, width, rows, a, b, c, _gamma, input + row * width))
+        {
+            free(input);
+            fprintf(stderr, "%s", "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    trace_end("greyscale and gamma", span_start);
+    FILE *fd = fopen(output_file_name, "w"); // open output file
+    if (!fd)                                 // check if fopen succeeded
+    {
+        free(input);
+        fprintf(stderr, "Cannot open output file. Program terminated.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!save_output_to_outputfile(width, height, input, fd)) // the output is the prefix of the input buffer
+    {
+        free(input);
+        fclose(fd);
+        fprintf(stderr, "Failed to write into output file. Program terminated.\n");
+        exit(EXIT_FAILURE);
+    }
+    free(input);
+    fclose(fd);
+}
+
+static void gamma_correct_frames(seq_kernel kernel)
+{
+    struct frame_state state = {0};
+    _Bool output_per_frame = output_has_frame_number();
+    for (int i = 0; i < number_of_frames; ++i)
+    {
+        size_t width, height;
+        uint8_t *input = readppm_for_seq(frame_file_names[i], &width, &height); // the state takes over the input, it is compared with the next frame
+        size_t dirty_tiles = frame_update(&state, input, width, height, kernel, a, b, c, _gamma);
+        if (!state.output)
+        {
+            fprintf(stderr, "%s", "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        size_t tiles = state.tiles_per_row * state.tile_rows;
+        char file_name[4096];
+        if (output_per_frame) // checked in check_values, '%d' is the only conversion
+        {
+            snprintf(file_name, sizeof(file_name), output_file_name, i + 1);
+        }
+        else
+        {
+            snprintf(file_name, sizeof(file_name), "%s", output_file_name);
+        }
+        _Bool success;
+        if (output_per_frame || dirty_tiles == tiles) // a new file or the whole image changed
+        {
+            FILE *fd = fopen(file_name, "w");
+            success = fd && save_output_to_outputfile(width, height, state.output, fd);
+            success = fd && fclose(fd) == 0 && success;
+        }
+        else // the output file still holds the previous frame, only the changed tiles are overwritten
+        {
+            success = frame_patch_output(&state, file_name);
+        }
+        if (!success)
+        {
+            frame_state_free(&state);
+            fprintf(stderr, "Failed to write into output file. Program terminated.\n");
+            exit(EXIT_FAILURE);
+        }
+        printf("frame %d: %lu of %lu tiles changed\n", i + 1, dirty_tiles, tiles);
+    }
+    frame_state_free(&state);
+}
+
+static _Bool output_has_frame_number(void)
+{
+    const char *conversion = strchr(output_file_name, '%');
+    return conversion && conversion[1] == 'd' && !strchr(conversion + 1, '%');
+}
+
 static _Bool save_output_to_outputfile(size_t width, size_t height, uint8_t *output, FILE *fd)
 { // fd has already been checked in the caller function, so it couldn't be NULL
+    uint64_t span_start = trace_begin();
     if (fprintf(fd, "P5\n%lu\n%lu\n255\n", width, height) < 0)
     { // if fprintf failed
         return false;
     }
-    if (fwrite(output, width * height, 1, fd) != 1)
-    { // write result into output file and check if succeeded
+    if (fwrite(output, width * height, 1, fd) != 1 || fflush(fd) != 0)
+    { // write result into output file and check if succeeded, flush so that the span covers the actual write
         return false;
     }
+    trace_end("write output", span_start);
+    return true;
+}
+
+static _Bool save_pyramid(struct pyramid *pyramid)
+{
+    for (int k = 0; k < PYRAMID_LEVELS; ++k)
+    {
+        char file_name[4096];
+        pyramid_file_name(file_name, sizeof(file_name), output_file_name, k);
+        FILE *fd = fopen(file_name, "w");
+        if (!fd)
+        {
+            return false;
+        }
+        _Bool success = save_output_to_outputfile(pyramid->width[k], pyramid->height[k], pyramid->level[k], fd);
+        if (fclose(fd) != 0 || !success)
+        {
+            return false;
+        }
+    }
     return true;
 }
 
@@ -6,6 +6,15 @@
 #include "readppm.h"
 #include "V1.h"
 #include "V2.h"
+#include "V3.h"
+#include "V4.h"
+#include "parallelio.h"
+#include "trace.h"
+#include "tune.h"
+#include "linear.h"
+#include "pyramid.h"
+#include "frames.h"
+#include "approx.h"
 
 #ifndef GAMMACORRECT_H
 #define GAMMACORRECT_H
@@ -19,14 +28,25 @@ static const char *usage_msg =
 static const char *help_msg = // should be updated at V B coeffs
     "Usage: %s [options] inputfile...\n"
     "Options:\n"
-    "  -V<int>                            Optional. Choose a version.\n"
+    "  -V<int>|auto                       Optional. Choose a version, auto takes version, threads and block size from the wisdom file.\n"
     "  -B<int>                            Optional. Choose how many times the function call will be repeated.\n"
+    "  -T<int>                            Optional. Read, convert and write the image in row slices with the given number of threads.\n"
     "  Inputfile                          Specify the name of the input file.\n"
     "  -o<string>                         Specify the name of the output file.\n"
     "  --coeffs<float>,<float>,<float>    Optional. Set the coefficients for the grey value conversion.\n"
     "  --gamma<float>                     Optional. Set gamma for gamma correction.\n"
+    "  --lut-cache<string>                Optional. Directory in which version 4 persists its lookup tables.\n"
+    "  --tune                             Optional. Benchmark all versions, thread counts and block sizes on the input, save the fastest into the wisdom file and use it.\n"
+    "  --wisdom<string>                   Optional. Wisdom file for option tune and -V auto, default is gammacorrect.wisdom.\n"
+    "  --linearize                        Optional. Convert the sRGB encoded colors to linear light before the greyscale conversion.\n"
+    "  --numa                             Optional. With option T, pin the threads to the NUMA nodes, so that every node processes its own part of the image in local memory, and report the bandwidth per node.\n"
+    "  --pyramid                          Optional. Also write the output box filtered to 1/2, 1/4 and 1/8 of its size, every level is built from the unrounded 2x2 sums of the previous one and rounded once, so inside the image a pixel is the rounded average of 2x2, 4x4 or 8x8 output pixels. If a level has an odd width or height, the last column or row of its own sums is repeated, so the right and bottom edge of 1/4 and 1/8 can differ from repeating the last output column and row. They are written into the output file name with _2, _4 and _8 before the extension. The levels are computed from the rows the kernel has just written, without reading the output again.\n"
+    "  --frames                           Optional. Take a sequence of input files of the same size, only the tiles which changed since the previous frame are converted. The output file is patched in place, if its name contains %%d one file per frame is written.\n"
+    "  --in-place                         Optional. Write the output into the already converted part of the input buffer. A P6 input is read straight into this buffer, so its peak memory is about the size of the pixel data. A P3 or P2 input is mapped while it is parsed.\n"
+    "  --max-error<float>                 Optional. Largest allowed difference to version 0 in LSB. The greyscale value is computed in fixed point and looked up in the coarsest gamma table whose error is proven to be within the budget, otherwise version 0 is used. Without options T, in-place and frames the achieved max and mean error against version 0 are reported.\n"
+    "  --trace<string>                    Optional. Record the duration of every phase and write it to the given file in Chrome trace-event format.\n"
     "  -h|--help                          Print help and exit.\n"
     "\n"
-    "This program takes a 24bpp ppm file as input and then convert it after greyscale conversion and gamma correction to a pgm file. The defualt coefficients for greyscale conversion are 0.299 for R, 0.587 for G, 0.114 for B. The default gamma for gamma correction is 1. With option V you can choose a version number from 0, 1, and 2. 0 is the default version number. If you want to benchmark this program, set option B. The default benchmark number is 1000. You can replace this number with an integer no less than 1000.\n";
+    "This program takes a 24bpp ppm file (binary P6 or ASCII P3, or an ASCII P2 pgm file) as input and then convert it after greyscale conversion and gamma correction to a pgm file. The defualt coefficients for greyscale conversion are 0.299 for R, 0.587 for G, 0.114 for B. The default gamma for gamma correction is 1. With option V you can choose a version number from 0, 1, 2, 3 and 4. 0 is the default version number. Version 3 detects runs of equal pixels and caches recently computed colors, it is fastest on synthetic images like diagrams and screenshots. Version 4 computes the result for all 2^24 colors once and then needs a single table lookup per pixel, with option lut-cache the table is saved per coefficients and gamma and mapped by later runs. Which version is fastest depends on the host, the image size and gamma, option tune measures it once per host, image size class, integer or fractional gamma and use of option lut-cache and -V auto reuses the result. With option linearize the colors are decoded from sRGB to linear light with one table per color, so the grey value is the real luminance, the default coefficients are then 0.2126, 0.7152 and 0.0722 and a gamma of 0.4545 encodes the result for display again. If you want to benchmark this program, set option B. The default benchmark number is 1000. You can replace this number with an integer no less than 1000. If option T is set, every thread reads its own rows of the input with pread and writes them with pwrite into the output file, then option B measures the whole pipeline including I/O.\n";
 
 #endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "linear.h"
+#define LINEAR_ONE 65535                  // linear luminance 1.0 in fixed point, the sum of the three channel tables never exceeds LINEAR_ONE + 2 because of rounding
+#define OUTPUT_TABLE_SIZE (LINEAR_ONE + 3) // + 2 for the rounding of the channel tables
+
+struct linear_tables // per channel decode tables with the weights folded in, and the gamma table indexed by the fixed point luminance
+{
+    uint32_t red[256];
+    uint32_t green[256];
+    uint32_t blue[256];
+    uint8_t output[OUTPUT_TABLE_SIZE];
+};
+
+static pthread_mutex_t tables_lock = PTHREAD_MUTEX_INITIALIZER; // with option T several threads may ask for the tables at the same time
+static struct linear_tables tables;                            // the tables of the last parameters, built once and reused by later calls and benchmark repetitions
+static float tables_key[4] = {-1, -1, -1, -1};                 // a, b, c and gamma of the tables, -1 is never a legal coefficient
+
+static const struct linear_tables *get_tables(float, float, float, float);
+static float srgb_to_linear(uint8_t);
+
+void gamma_correct_linear(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result)
+{
+    const struct linear_tables *lut = get_tables(a, b, c, gamma);
+    size_t num_pixel = width * height;
+    for (size_t i = 0; i < num_pixel; ++i) // three lookups and two adds give the linear luminance, one more lookup the gamma corrected output
+    {
+        result[i] = lut->output[lut->red[img[3 * i]] + lut->green[img[3 * i + 1]] + lut->blue[img[3 * i + 2]]];
+    }
+}
+
+static const struct linear_tables *get_tables(float a, float b, float c, float gamma)
+{
+    pthread_mutex_lock(&tables_lock);
+    if (tables_key[0] != a || tables_key[1] != b || tables_key[2] != c || tables_key[3] != gamma)
+    {
+        float sum_coeffs = a + b + c;
+        for (int value = 0; value < 256; ++value) // 3 * 256 pow calls instead of three per pixel
+        {
+            float linear = srgb_to_linear(value);
+            tables.red[value] = lroundf(a / sum_coeffs * linear * LINEAR_ONE);
+            tables.green[value] = lroundf(b / sum_coeffs * linear * LINEAR_ONE);
+            tables.blue[value] = lroundf(c / sum_coeffs * linear * LINEAR_ONE);
+        }
+        for (int luminance = 0; luminance < OUTPUT_TABLE_SIZE; ++luminance)
+        {
+            float clamped = luminance < LINEAR_ONE ? (float)luminance / LINEAR_ONE : 1; // the sum may exceed LINEAR_ONE by the rounding of the three tables
+            tables.output[luminance] = roundf(pow(clamped, gamma) * 255);
+        }
+        tables_key[0] = a;
+        tables_key[1] = b;
+        tables_key[2] = c;
+        tables_key[3] = gamma;
+    }
+    pthread_mutex_unlock(&tables_lock);
+    return &tables;
+}
+
+static float srgb_to_linear(uint8_t value) // inverse of the sRGB transfer function
+{
+    float encoded = value / 255.0f;
+    return encoded <= 0.04045f ? encoded / 12.92f : pow((encoded + 0.055f) / 1.055f, 2.4f);
+}
@@ -0,0 +1,10 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#ifndef LINEAR_H
+#define LINEAR_H
+void gamma_correct_linear(const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result); // decode sRGB to linear light before the greyscale conversion
+#endif
@@ -0,0 +1,128 @@
+#define _GNU_SOURCE // cpu_set_t and pthread_attr_setaffinity_np
+#include "numa.h"
+
+struct node // a NUMA node with at least one CPU
+{
+    int id;
+    cpu_set_t cpus;
+};
+
+static struct node nodes[NUMA_MAX_NODES];
+static size_t number_of_nodes = 0; // 0 until numa_discover ran
+
+static _Bool parse_cpulist(const char *, cpu_set_t *); // parse a list like "0-3,8-11"
+
+size_t numa_discover(void)
+{
+    if (number_of_nodes > 0)
+    {
+        return number_of_nodes;
+    }
+    DIR *dir = opendir("/sys/devices/system/node");
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) && number_of_nodes < NUMA_MAX_NODES)
+    {
+        int id;
+        char extra;
+        if (sscanf(entry->d_name, "node%d%c", &id, &extra) != 1) // only the directories node0, node1, ...
+        {
+            continue;
+        }
+        char path[320];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", entry->d_name);
+        FILE *fd = fopen(path, "r");
+        char cpulist[4096];
+        if (!fd)
+        {
+            continue;
+        }
+        if (fgets(cpulist, sizeof(cpulist), fd) && parse_cpulist(cpulist, &nodes[number_of_nodes].cpus)) // nodes without CPUs, e.g. pure memory nodes, are skipped
+        {
+            nodes[number_of_nodes++].id = id;
+        }
+        fclose(fd);
+    }
+    if (dir)
+    {
+        closedir(dir);
+    }
+    for (size_t i = 1; i < number_of_nodes; ++i) // readdir has no order, sort by id with insertion sort
+    {
+        for (size_t j = i; j > 0 && nodes[j - 1].id > nodes[j].id; --j)
+        {
+            struct node tmp = nodes[j];
+            nodes[j] = nodes[j - 1];
+            nodes[j - 1] = tmp;
+        }
+    }
+    if (number_of_nodes == 0) // no sysfs, e.g. not Linux or in a restricted container, treat the host as one node without pinning
+    {
+        nodes[0].id = -1;
+        number_of_nodes = 1;
+    }
+    return number_of_nodes;
+}
+
+_Bool numa_bind_thread_attr(pthread_attr_t *attr, size_t node)
+{
+    if (nodes[node].id < 0) // unknown topology
+    {
+        return false;
+    }
+    return pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &nodes[node].cpus) == 0;
+}
+
+void numa_report(const struct numa_bandwidth *bandwidth)
+{
+    double bytes = 0;
+    double seconds = 0; // the nodes run in parallel, so the slowest one determines the time of all threads
+    for (size_t node = 0; node < number_of_nodes; ++node)
+    {
+        bytes += bandwidth->bytes[node];
+        seconds = bandwidth->seconds[node] > seconds ? bandwidth->seconds[node] : seconds;
+    }
+    if (bandwidth->unpinned) // the threads may run on any node, a bandwidth per node would be misleading
+    {
+        fprintf(stderr, "Warning: the threads could not be pinned to their NUMA nodes.\n");
+        printf("All threads: %lfMB/s\n", seconds > 0 ? bytes / seconds / 1e6 : 0);
+        return;
+    }
+    for (size_t node = 0; node < number_of_nodes; ++node)
+    {
+        if (bandwidth->threads[node] > 0)
+        {
+            printf("NUMA node %d: %lu threads, %lfMB/s\n", nodes[node].id, bandwidth->threads[node], bandwidth->seconds[node] > 0 ? bandwidth->bytes[node] / bandwidth->seconds[node] / 1e6 : 0);
+        }
+    }
+}
+
+static _Bool parse_cpulist(const char *cpulist, cpu_set_t *cpus)
+{
+    CPU_ZERO(cpus);
+    const char *ptr = cpulist;
+    while (*ptr && *ptr != '\n')
+    {
+        char *end;
+        long first = strtol(ptr, &end, 10);
+        if (end == ptr)
+        {
+            return false;
+        }
+        long last = first;
+        if (*end == '-')
+        {
+            ptr = end + 1;
+            last = strtol(ptr, &end, 10);
+            if (end == ptr)
+            {
+                return false;
+            }
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+        {
+            CPU_SET(cpu, cpus);
+        }
+        ptr = *end == ',' ? end + 1 : end;
+    }
+    return CPU_COUNT(cpus) > 0;
+}
@@ -0,0 +1,24 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+#ifndef NUMA_H
+#define NUMA_H
+#define NUMA_MAX_NODES 64
+
+struct numa_bandwidth // bytes and time per node, summed over all runs of parallel I/O, so that a benchmark is reported once
+{
+    size_t threads[NUMA_MAX_NODES]; // threads per node in one run
+    double bytes[NUMA_MAX_NODES];
+    double seconds[NUMA_MAX_NODES]; // per run the time of the slowest thread of the node
+    _Bool unpinned;                 // a thread could not be pinned to its node, then the nodes are not reported separately
+};
+
+size_t numa_discover(void);                                  // read the node topology from sysfs once, returns the number of nodes with CPUs, 1 if the topology is unknown
+_Bool numa_bind_thread_attr(pthread_attr_t *attr, size_t node); // threads created with attr only run on the CPUs of node, returns false if that is not possible
+void numa_report(const struct numa_bandwidth *bandwidth);        // print the bandwidth of every node, or of all threads with a warning if pinning failed
+#endif
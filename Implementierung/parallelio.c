@@ -0,0 +1,372 @@
+#include "parallelio.h"
+
+struct slice // every thread owns one slice of rows, from reading the input to writing the output, so no buffer is shared between threads
+{
+    int input_fd;
+    int output_fd;
+    off_t input_offset;  // offset of the first pixel of this slice in the input file
+    off_t output_offset; // offset of the first pixel of this slice in the output file
+    size_t width;
+    size_t rows;
+    size_t block_rows; // number of rows read, transformed and written at once, 0 means the whole slice
+    seq_kernel kernel; // NULL selects the SIMD version V2, which needs the colors in separate float buffers
+    float a, b, c, gamma;
+    const char *err_msg; // NULL if the slice is processed successfully, otherwise the reason of failure
+    size_t node;         // NUMA node the thread runs on, its buffers are first touched there
+    double seconds;      // time the thread needed for its slice, used for the bandwidth report
+    const struct pyramid_output *pyramid; // NULL if no pyramid is written
+    size_t first_row;                     // first row of this slice in the image, to find its rows in the pyramid levels
+};
+
+struct pyramid_output // the files of the pyramid levels, shared read only by all threads
+{
+    int fd[PYRAMID_LEVELS];
+    off_t header_length[PYRAMID_LEVELS];
+};
+
+static void *process_slice(void *);                                                  // thread function, pread the slice, transform it and pwrite it
+static void add_bandwidth(const struct slice *, size_t, struct numa_bandwidth *);     // add the bytes read and written and the time of every NUMA node
+static _Bool open_pyramid_output(const char *, size_t, size_t, struct pyramid_output *); // create the level files with their headers and pre-size them
+static _Bool close_pyramid_output(struct pyramid_output *);                          // close the level files, returns false if a delayed write error is reported
+static _Bool write_pyramid_block(const struct slice *, struct pyramid *, const uint8_t *, size_t, size_t); // reduce the transformed rows of a block and pwrite them into the level files
+
+void gamma_correct_parallel_io(const char *input_file, const char *output_file, seq_kernel kernel, size_t number_of_threads, size_t block_rows, struct numa_bandwidth *numa, _Bool pyramid, float a, float b, float c, float gamma)
+{
+    size_t width, height;
+    char magic;
+    size_t input_header_length = readppm_header_length(input_file, &width, &height, &magic); // the header is parsed once with the state machine, afterwards only the pixel payload is read
+    if (magic != '6') // the offsets of the slices are only known for binary pixels
+    {
+        fprintf(stderr, "Option T requires a binary P6 input file. Program terminated.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (kernel == gamma_correct_V4) // otherwise the first slice would build the table inside its timed region and the bandwidth of its node would include it
+    {
+        lut24_prepare(a, b, c, gamma);
+    }
+    char output_header[64];
+    int output_header_length = snprintf(output_header, sizeof(output_header), "P5\n%lu\n%lu\n255\n", width, height);
+    int input_fd = open(input_file, O_RDONLY);
+    if (input_fd < 0)
+    {
+        fprintf(stderr, "Cannot open your input file. Please check your input file.\n");
+        exit(EXIT_FAILURE);
+    }
+    int output_fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0)
+    {
+        close(input_fd);
+        fprintf(stderr, "Cannot open output file. Program terminated.\n");
+        exit(EXIT_FAILURE);
+    }
+    // pre-size the output file, so that every thread can pwrite its slice at its own offset independently
+    if (!pwrite_all(output_fd, (const uint8_t *)output_header, output_header_length, 0) || ftruncate(output_fd, output_header_length + width * height) != 0)
+    {
+        close(input_fd);
+        close(output_fd);
+        fprintf(stderr, "Failed to write into output file. Program terminated.\n");
+        exit(EXIT_FAILURE);
+    }
+    struct pyramid_output pyramid_output;
+    if (pyramid && !open_pyramid_output(output_file, width, height, &pyramid_output))
+    {
+        close(input_fd);
+        close(output_fd);
+        fprintf(stderr, "Cannot open pyramid output file. Program terminated.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t granule = pyramid ? PYRAMID_STRIPE_ROWS : 1; // with a pyramid slices and blocks start at a row of the smallest level, so every thread writes whole rows of all levels
+    size_t granules = (height + granule - 1) / granule;
+    if (number_of_threads > granules) // slices are row aligned, so there can't be more threads than rows
+    {
+        number_of_threads = granules;
+    }
+    block_rows = (block_rows + granule - 1) / granule * granule;
+    struct slice *slices = malloc(number_of_threads * sizeof(struct slice));
+    pthread_t *threads = malloc(number_of_threads * sizeof(pthread_t));
+    if (!slices || !threads)
+    {
+        free(slices);
+        free(threads);
+        close(input_fd);
+        close(output_fd);
+        if (pyramid)
+        {
+            close_pyramid_output(&pyramid_output);
+        }
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t number_of_nodes = numa ? numa_discover() : 1;
+    size_t first_row = 0;
+    size_t started_threads = 0;
+    for (size_t i = 0; i < number_of_threads; ++i)
+    {
+        size_t rows = (granules / number_of_threads + (i < granules % number_of_threads)) * granule; // distribute the remaining rows to the first threads
+        rows = rows < height - first_row ? rows : height - first_row;                             // the last granule may be shorter
+        size_t node = i * number_of_nodes / number_of_threads;                      // consecutive threads share a node, so every node processes one contiguous part of the image
+        slices[i] = (struct slice){input_fd, output_fd, input_header_length + first_row * width * 3, output_header_length + first_row * width, width, rows, block_rows, kernel, a, b, c, gamma, NULL, node, 0, pyramid ? &pyramid_output : NULL, first_row};
+        first_row += rows;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (numa && !numa_bind_thread_attr(&attr, node)) // pin the thread before it starts, so that its buffers are first touched on its node
+        {
+            numa->unpinned = true;
+        }
+        int create_failed = pthread_create(&threads[i], &attr, process_slice, &slices[i]);
+        pthread_attr_destroy(&attr);
+        if (create_failed) // the slices which have not been started are reported as failed below
+        {
+            slices[i].err_msg = "Cannot create thread. Program terminated.\n";
+            break;
+        }
+        ++started_threads;
+    }
+    for (size_t i = 0; i < started_threads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    if (numa && started_threads == number_of_threads)
+    {
+        add_bandwidth(slices, number_of_threads, numa);
+    }
+    const char *err_msg = NULL;
+    for (size_t i = 0; i < number_of_threads && !err_msg; ++i) // report the first failed slice
+    {
+        err_msg = slices[i].err_msg;
+    }
+    free(slices);
+    free(threads);
+    close(input_fd);
+    if (close(output_fd) != 0 && !err_msg) // delayed write errors are reported by close
+    {
+        err_msg = "Failed to write into output file. Program terminated.\n";
+    }
+    if (pyramid && !close_pyramid_output(&pyramid_output) && !err_msg)
+    {
+        err_msg = "Failed to write into pyramid output file. Program terminated.\n";
+    }
+    if (err_msg)
+    {
+        fprintf(stderr, "%s", err_msg);
+        exit(EXIT_FAILURE);
+    }
+}
+
+seq_kernel kernel_of_version(int version)
+{
+    switch (version)
+    {
+    case 0:
+        return gamma_correct;
+    case 1:
+        return gamma_correct_V1;
+    case 3:
+        return gamma_correct_V3;
+    case 4:
+        return gamma_correct_V4;
+    default: // V2
+        return NULL;
+    }
+}
+
+_Bool transform_rows(seq_kernel kernel, const uint8_t *input, size_t width, size_t rows, float a, float b, float c, float gamma, uint8_t *output)
+{
+    if (kernel)
+    {
+        kernel(input, width, rows, a, b, c, gamma, output);
+        return true;
+    }
+    // same layout as readppm_for_simd, but only for the given rows
+    size_t number_of_pixels = width * rows;
+    size_t color_buffer_size = ((number_of_pixels << 2) & 0xfffffffffffffff0) + 16; // size of buffer for each color, should be an integer multiple time of 16
+    float *red = aligned_alloc(16, color_buffer_size);
+    float *green = aligned_alloc(16, color_buffer_size);
+    float *blue = aligned_alloc(16, color_buffer_size);
+    if (!red || !green || !blue)
+    {
+        free(red);
+        free(green);
+        free(blue);
+        return false;
+    }
+    uint64_t span_start = trace_begin();
+    for (size_t i = 0; i < number_of_pixels; ++i)
+    {
+        red[i] = input[3 * i];
+        green[i] = input[3 * i + 1];
+        blue[i] = input[3 * i + 2];
+    }
+    trace_end("deinterleave block", span_start);
+    _Bool success = gamma_correct_V2(red, green, blue, width, rows, a, b, c, gamma, output);
+    free(red);
+    free(green);
+    free(blue);
+    return success;
+}
+
+static void add_bandwidth(const struct slice *slices, size_t number_of_threads, struct numa_bandwidth *bandwidth)
+{
+    double seconds[NUMA_MAX_NODES] = {0}; // the threads of a node run in parallel, so the slowest one determines the time of the node
+    for (size_t node = 0; node < NUMA_MAX_NODES; ++node)
+    {
+        bandwidth->threads[node] = 0;
+    }
+    for (size_t i = 0; i < number_of_threads; ++i)
+    {
+        size_t node = slices[i].node;
+        ++bandwidth->threads[node];
+        bandwidth->bytes[node] += slices[i].width * slices[i].rows * 4; // three bytes read and one byte written per pixel
+        seconds[node] = slices[i].seconds > seconds[node] ? slices[i].seconds : seconds[node];
+    }
+    for (size_t node = 0; node < NUMA_MAX_NODES; ++node)
+    {
+        bandwidth->seconds[node] += seconds[node];
+    }
+}
+
+static _Bool open_pyramid_output(const char *output_file, size_t width, size_t height, struct pyramid_output *pyramid_output)
+{
+    _Bool success = true;
+    for (int k = 0; k < PYRAMID_LEVELS; ++k)
+    {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        char file_name[4096];
+        pyramid_file_name(file_name, sizeof(file_name), output_file, k);
+        char header[64];
+        int header_length = snprintf(header, sizeof(header), "P5\n%lu\n%lu\n255\n", width, height);
+        pyramid_output->header_length[k] = header_length;
+        pyramid_output->fd[k] = success ? open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+        success = success && pyramid_output->fd[k] >= 0 && pwrite_all(pyramid_output->fd[k], (const uint8_t *)header, header_length, 0) && ftruncate(pyramid_output->fd[k], header_length + width * height) == 0;
+    }
+    if (!success)
+    {
+        close_pyramid_output(pyramid_output);
+    }
+    return success;
+}
+
+static _Bool close_pyramid_output(struct pyramid_output *pyramid_output)
+{
+    _Bool success = true;
+    for (int k = 0; k < PYRAMID_LEVELS; ++k)
+    {
+        if (pyramid_output->fd[k] >= 0 && close(pyramid_output->fd[k]) != 0)
+        {
+            success = false;
+        }
+    }
+    return success;
+}
+
+static _Bool write_pyramid_block(const struct slice *slice, struct pyramid *pyramid, const uint8_t *output, size_t row, size_t rows)
+{
+    pyramid_add_rows(pyramid, output, slice->width, 0, rows); // the levels of the block start at their first row
+    uint64_t span_start = trace_begin();
+    size_t image_row = slice->first_row + row; // a multiple of PYRAMID_STRIPE_ROWS, so it maps to whole rows of every level
+    for (int k = 0; k < PYRAMID_LEVELS; ++k)
+    {
+        image_row /= 2;
+        rows = (rows + 1) / 2;
+        if (!pwrite_all(slice->pyramid->fd[k], pyramid->level[k], rows * pyramid->width[k], slice->pyramid->header_length[k] + image_row * pyramid->width[k]))
+        {
+            return false;
+        }
+    }
+    trace_end("pwrite pyramid", span_start);
+    return true;
+}
+
+static void *process_slice(void *arg)
+{
+    struct slice *slice = arg;
+    uint64_t slice_start = trace_begin();
+    uint64_t clock_start = trace_clock();
+    size_t rows_per_block = slice->block_rows && slice->block_rows < slice->rows ? slice->block_rows : slice->rows; // a block is read, transformed and written at once
+    uint8_t *input = malloc(slice->width * rows_per_block * 3);
+    uint8_t *output = malloc(slice->width * rows_per_block);
+    struct pyramid pyramid = {0};
+    if (!input || !output || (slice->pyramid && !pyramid_alloc(&pyramid, slice->width, rows_per_block))) // the levels of one block, the thread writes them after every block
+    {
+        free(input);
+        free(output);
+        slice->err_msg = "memory allocation failed\n";
+        return NULL;
+    }
+    for (size_t row = 0; row < slice->rows && !slice->err_msg; row += rows_per_block)
+    {
+        size_t rows = slice->rows - row < rows_per_block ? slice->rows - row : rows_per_block;
+        size_t number_of_pixels = slice->width * rows;
+        uint64_t span_start = trace_begin();
+        if (!pread_all(slice->input_fd, input, number_of_pixels * 3, slice->input_offset + row * slice->width * 3))
+        {
+            slice->err_msg = "Read pixel values of input file failed. Is your input file deprecated?\n";
+            break;
+        }
+        trace_end("pread block", span_start);
+        span_start = trace_begin();
+        if (!transform_rows(slice->kernel, input, slice->width, rows, slice->a, slice->b, slice->c, slice->gamma, output))
+        {
+            slice->err_msg = "memory allocation failed\n";
+            break;
+        }
+        trace_end("transform block", span_start);
+        span_start = trace_begin();
+        if (!pwrite_all(slice->output_fd, output, number_of_pixels, slice->output_offset + row * slice->width))
+        {
+            slice->err_msg = "Failed to write into output file. Program terminated.\n";
+        }
+        trace_end("pwrite block", span_start);
+        if (slice->pyramid && !slice->err_msg && !write_pyramid_block(slice, &pyramid, output, row, rows))
+        {
+            slice->err_msg = "Failed to write into pyramid output file. Program terminated.\n";
+        }
+    }
+    free(input);
+    free(output);
+    pyramid_free(&pyramid);
+    slice->seconds = (trace_clock() - clock_start) * 1e-9;
+    trace_end("slice", slice_start);
+    return NULL;
+}
+
+_Bool pread_all(int fd, uint8_t *buffer, size_t count, off_t offset)
+{
+    while (count > 0)
+    {
+        ssize_t success_read = pread(fd, buffer, count, offset);
+        if (success_read < 0 && errno == EINTR) // interrupted by a signal, try again
+        {
+            continue;
+        }
+        if (success_read <= 0) // read error or the input file is shorter than the metadata says
+        {
+            return false;
+        }
+        buffer += success_read;
+        offset += success_read;
+        count -= success_read;
+    }
+    return true;
+}
+
+_Bool pwrite_all(int fd, const uint8_t *buffer, size_t count, off_t offset)
+{
+    while (count > 0)
+    {
+        ssize_t success_write = pwrite(fd, buffer, count, offset);
+        if (success_write < 0 && errno == EINTR) // interrupted by a signal, try again
+        {
+            continue;
+        }
+        if (success_write <= 0)
+        {
+            return false;
+        }
+        buffer += success_write;
+        offset += success_write;
+        count -= success_write;
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "V0.h"
+#include "V1.h"
+#include "V2.h"
+#include "V3.h"
+#include "V4.h"
+#include "readppm.h"
+#include "trace.h"
+#include "numa.h"
+#include "pyramid.h"
+
+#ifndef PARALLELIO_H
+#define PARALLELIO_H
+void gamma_correct_parallel_io(const char *input_file, const char *output_file, seq_kernel kernel, size_t number_of_threads, size_t block_rows, struct numa_bandwidth *numa, _Bool pyramid, float a, float b, float c, float gamma); // block_rows 0 means every thread handles its slice at once, a non NULL numa pins the threads to the nodes and adds their bandwidth, pyramid writes the levels next to the output
+seq_kernel kernel_of_version(int version);                                                                                                  // kernel of a version working on interleaved RGB bytes, NULL for V2
+_Bool transform_rows(seq_kernel kernel, const uint8_t *input, size_t width, size_t rows, float a, float b, float c, float gamma, uint8_t *output); // run the kernel on interleaved RGB rows, a NULL kernel deinterleaves the rows for V2, returns false if allocation failed
+_Bool pread_all(int fd, uint8_t *buffer, size_t count, off_t offset);                                                                              // pread until count bytes are read, pread may return less bytes than requested
+_Bool pwrite_all(int fd, const uint8_t *buffer, size_t count, off_t offset);                                                                       // pwrite until count bytes are written, pwrite may write less bytes than requested
+#endif
@@ -0,0 +1,155 @@
+#include "pyramid.h"
+#define STRIPE_PIXELS 16384 // a stripe of the fused pass covers at least this many pixels, so that the kernel is not called for every few pixels of a narrow image
+
+static void sum_pixels(const uint8_t *, size_t, size_t, uint16_t *); // sums of 2x2 pixels of rows into (rows + 1) / 2 rows, the last row and column are repeated if the size is odd
+static void sum_sums(const uint16_t *, size_t, size_t, uint16_t *);   // the same for the sums of the previous level, the last row and column of these sums are repeated, not the last output pixels
+static void add_stripe(struct pyramid *, const uint8_t *, size_t, size_t, size_t); // reduce at most PYRAMID_STRIPE_ROWS rows into all levels
+static size_t fused_stripe_rows(size_t);                                         // rows of a stripe of the fused pass, a multiple of PYRAMID_STRIPE_ROWS
+
+_Bool pyramid_alloc(struct pyramid *pyramid, size_t width, size_t height)
+{
+    _Bool success = true;
+    memset(pyramid->level, 0, sizeof(pyramid->level)); // so that pyramid_free works if an allocation fails
+    memset(pyramid->sums, 0, sizeof(pyramid->sums));
+    for (int k = 0; k < PYRAMID_LEVELS; ++k)
+    {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        pyramid->width[k] = width;
+        pyramid->height[k] = height;
+        pyramid->level[k] = malloc(width * height + 1); // + 1 so that malloc never gets 0
+        pyramid->sums[k] = malloc(width * (PYRAMID_STRIPE_ROWS >> (k + 1)) * sizeof(uint16_t) + 1);
+        success = success && pyramid->level[k] && pyramid->sums[k];
+    }
+    if (!success)
+    {
+        pyramid_free(pyramid);
+    }
+    return success;
+}
+
+void pyramid_free(struct pyramid *pyramid)
+{
+    for (int k = 0; k < PYRAMID_LEVELS; ++k)
+    {
+        free(pyramid->level[k]);
+        free(pyramid->sums[k]);
+        pyramid->level[k] = NULL;
+        pyramid->sums[k] = NULL;
+    }
+}
+
+void pyramid_add_rows(struct pyramid *pyramid, const uint8_t *rows, size_t width, size_t first_row, size_t number_of_rows)
+{
+    uint64_t span_start = trace_begin();
+    for (size_t row = 0; row < number_of_rows; row += PYRAMID_STRIPE_ROWS)
+    {
+        size_t rows_of_stripe = number_of_rows - row < PYRAMID_STRIPE_ROWS ? number_of_rows - row : PYRAMID_STRIPE_ROWS;
+        add_stripe(pyramid, rows + row * width, width, first_row + row, rows_of_stripe);
+    }
+    trace_end("pyramid", span_start);
+}
+
+void gamma_correct_pyramid(seq_kernel kernel, const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result, struct pyramid *pyramid)
+{
+    size_t stripe_rows = fused_stripe_rows(width);
+    for (size_t row = 0; row < height; row += stripe_rows)
+    {
+        size_t rows = height - row < stripe_rows ? height - row : stripe_rows;
+        kernel(img + row * width * 3, width, rows, a, b, c, gamma, result + row * width);
+        pyramid_add_rows(pyramid, result + row * width, width, row, rows);
+    }
+}
+
+_Bool gamma_correct_pyramid_V2(const float *red, const float *green, const float *blue, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result, struct pyramid *pyramid)
+{
+    size_t stripe_rows = fused_stripe_rows(width);
+    for (size_t row = 0; row < height; row += stripe_rows)
+    {
+        size_t rows = height - row < stripe_rows ? height - row : stripe_rows;
+        size_t offset = row * width; // a multiple of 8 pixels, so the planes of every stripe stay aligned for the aligned loads of V2
+        if (!gamma_correct_V2(red + offset, green + offset, blue + offset, width, rows, a, b, c, gamma, result + offset))
+        {
+            return false;
+        }
+        pyramid_add_rows(pyramid, result + offset, width, row, rows);
+    }
+    return true;
+}
+
+void pyramid_file_name(char *buffer, size_t size, const char *output_file, int level)
+{
+    const char *slash = strrchr(output_file, '/');
+    const char *dot = strrchr(output_file, '.');
+    int base_length = dot && dot > (slash ? slash : output_file) ? (int)(dot - output_file) : (int)strlen(output_file); // a dot in a directory name or at the start of a hidden file is no extension
+    snprintf(buffer, size, "%.*s_%d%s", base_length, output_file, 2 << level, output_file + base_length);
+}
+
+static void add_stripe(struct pyramid *pyramid, const uint8_t *rows, size_t width, size_t first_row, size_t number_of_rows)
+{
+    for (int k = 0; k < PYRAMID_LEVELS; ++k) // level k sums 2^(k+1) x 2^(k+1) pixels, at most 64 * 255, which fits into 16 bits
+    {
+        if (k == 0)
+        {
+            sum_pixels(rows, width, number_of_rows, pyramid->sums[0]);
+        }
+        else
+        {
+            sum_sums(pyramid->sums[k - 1], pyramid->width[k - 1], number_of_rows, pyramid->sums[k]);
+        }
+        number_of_rows = (number_of_rows + 1) / 2;
+        first_row /= 2;
+        int shift = 2 * (k + 1); // divide by the number of summed pixels and round to nearest
+        size_t pixels = number_of_rows * pyramid->width[k];
+        const uint16_t *sums = pyramid->sums[k];
+        uint8_t *level_rows = pyramid->level[k] + first_row * pyramid->width[k];
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            level_rows[i] = (sums[i] + (1 << (shift - 1))) >> shift;
+        }
+    }
+}
+
+static void sum_pixels(const uint8_t *rows, size_t width, size_t number_of_rows, uint16_t *result)
+{
+    size_t result_width = (width + 1) / 2;
+    for (size_t y = 0; y < number_of_rows; y += 2)
+    {
+        const uint8_t *top = rows + y * width;
+        const uint8_t *bottom = y + 1 < number_of_rows ? top + width : top;
+        uint16_t *result_row = result + y / 2 * result_width;
+        for (size_t x = 0; x < width / 2; ++x) // pairs of rows are added in 16 bit lanes, the compiler keeps them in vector registers
+        {
+            result_row[x] = top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1];
+        }
+        if (width & 1)
+        {
+            result_row[width / 2] = 2 * top[width - 1] + 2 * bottom[width - 1];
+        }
+    }
+}
+
+static void sum_sums(const uint16_t *rows, size_t width, size_t number_of_rows, uint16_t *result)
+{
+    size_t result_width = (width + 1) / 2;
+    for (size_t y = 0; y < number_of_rows; y += 2)
+    {
+        const uint16_t *top = rows + y * width;
+        const uint16_t *bottom = y + 1 < number_of_rows ? top + width : top;
+        uint16_t *result_row = result + y / 2 * result_width;
+        for (size_t x = 0; x < width / 2; ++x)
+        {
+            result_row[x] = top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1];
+        }
+        if (width & 1)
+        {
+            result_row[width / 2] = 2 * top[width - 1] + 2 * bottom[width - 1];
+        }
+    }
+}
+
+static size_t fused_stripe_rows(size_t width)
+{
+    size_t stripe_rows = (STRIPE_PIXELS / (width ? width : 1) + PYRAMID_STRIPE_ROWS - 1) & ~(size_t)(PYRAMID_STRIPE_ROWS - 1); // a multiple of PYRAMID_STRIPE_ROWS, so every stripe starts at a row of the smallest level
+    return stripe_rows ? stripe_rows : PYRAMID_STRIPE_ROWS;
+}
@@ -0,0 +1,28 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "V0.h"
+#include "V2.h"
+#include "trace.h"
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+#define PYRAMID_LEVELS 3                          // 1/2, 1/4 and 1/8 of the full resolution
+#define PYRAMID_STRIPE_ROWS (1 << PYRAMID_LEVELS) // rows of the full resolution which reduce to one row of the smallest level
+
+struct pyramid // box filtered levels of an image or of a block of its rows, level k has ceil(width / 2^(k+1)) x ceil(height / 2^(k+1)) pixels
+{
+    size_t width[PYRAMID_LEVELS];
+    size_t height[PYRAMID_LEVELS];
+    uint8_t *level[PYRAMID_LEVELS];
+    uint16_t *sums[PYRAMID_LEVELS]; // unrounded sums of one stripe per level, the next level is built from them, so every level is rounded only once
+};
+
+_Bool pyramid_alloc(struct pyramid *pyramid, size_t width, size_t height);                                      // allocate all levels for a width x height image, returns false if allocation failed
+void pyramid_free(struct pyramid *pyramid);                                                                     // release all levels
+void pyramid_add_rows(struct pyramid *pyramid, const uint8_t *rows, size_t width, size_t first_row, size_t number_of_rows); // reduce rows of the full resolution into all levels, first_row has to be a multiple of PYRAMID_STRIPE_ROWS
+void gamma_correct_pyramid(seq_kernel kernel, const uint8_t *img, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result, struct pyramid *pyramid); // run the kernel stripe by stripe and reduce every stripe while it is still in cache
+_Bool gamma_correct_pyramid_V2(const float *red, const float *green, const float *blue, size_t width, size_t height, float a, float b, float c, float gamma, uint8_t *result, struct pyramid *pyramid); // the same for V2 on the planes of readppm_for_simd, returns false if V2 can't allocate its grey scale values
+void pyramid_file_name(char *buffer, size_t size, const char *output_file, int level);                         // output_file with _2, _4 or _8 before the extension
+#endif
@@ -1,162 +1,312 @@
 #include "readppm.h"
-// for all functions here, if fd is zero, then it's undefined behaviour
-// state machine for magic number part, three functions for three possible status
-static void magic_number_s0(FILE *fd);
-static void magic_number_s1(FILE *fd);
-static void magic_number_s2(FILE *fd);
-// state machine for width, height and maxval part, two functions for two possible status
-static struct digits_chain *getsize_s0(FILE *fd);                                                                // this function returns the head of a single linked list, every node of this list stores a digit
-static void getsize_s1(FILE *fd, struct digits_chain *start);                                                    // append the following digits to digits chain
-static size_t get_number_from_digits(struct digits_chain *start);                                                // get number and free all allocated space for digits chain
-static void enter_and_exit_comment_with_errorfree(FILE *fd, struct digits_chain *start);                         // if program is exiting with error in a comment, then the allocated memory should be freed, and the file should be closed
-static void free_from_start(struct digits_chain *start);                                                         // helper function to release a single linked list from head
-static void exit_failure_with_errmessage_and_release(FILE *fd, struct digits_chain *start, const char *err_msg); // close input file and release allocated memory for a linked list, if start is NULL, then only close fd
-
-static FILE *get_metadata(const char *input_file, size_t *width, size_t *height); // read metadata from input file and returns a file descriptor which points to the start of the image content
+#include "parallelio.h"
+#define SWAR_ONES 0x0101010101010101ull // 0x01 in every byte of a 64 bit word
 
-struct digits_chain // linked list to store width, height and maxval, then convert the list to size_t
+struct ppm_file // the whole input file mapped into memory, the header and ASCII samples are parsed in place
 {
-    char digit;
-    struct digits_chain *next;
+    const uint8_t *data;
+    size_t size;
+    size_t position; // index of the next unparsed byte
+    _Bool mapped;    // false if data is a heap buffer, because the input file can't be mapped
+    char magic;      // '6' for P6, '3' for P3 and '2' for P2
+    int fd;          // kept open until close_input, so the P6 payload is read from the same file as the header
 };
 
+static void open_input(const char *input_file, struct ppm_file *file);                         // map the input file, or read it into a heap buffer if mapping is not possible
+static void release_data(struct ppm_file *file);                                              // unmap or free the content of the input file, the descriptor stays open
+static void close_input(struct ppm_file *file);                                                // release the content and close the input file
+static void get_metadata(const char *input_file, struct ppm_file *file, size_t *width, size_t *height); // open the input file and parse the header, afterwards position points to the start of the image content
+// state machine for magic number part, three functions for three possible status
+static void magic_number_s0(struct ppm_file *file);
+static void magic_number_s1(struct ppm_file *file);
+static void magic_number_s2(struct ppm_file *file);
+// state machine for width, height and maxval part, two functions for two possible status, the digits are accumulated in place
+static size_t getsize_s0(struct ppm_file *file);              // skip whitespaces and comments until the first digit, returns its value
+static size_t getsize_s1(struct ppm_file *file, size_t value); // append the following digits to value until a whitespace
+static int next_char(struct ppm_file *file);                  // returns EOF at the end of the file
+static void enter_and_exit_comment_with_errorfree(struct ppm_file *file);
+static void skip_separators(struct ppm_file *file);           // skip whitespaces and comments before a sample of P3 or P2
+static uint8_t parse_sample(struct ppm_file *file);           // parse one decimal sample of P3 or P2 with SWAR, including the whitespaces and comments before it
+static void exit_failure_with_errmessage_and_release(struct ppm_file *file, const char *err_msg); // release the input file and exit with an error message
+
 uint8_t *readppm_for_seq(const char *input_file, size_t *width, size_t *height)
-{ // result used for V0 and V1
-    FILE *fd = get_metadata(input_file, width, height);
-    uint8_t *value_of_pixels = malloc((*width) * (*height) * 3); // allocate memory for input
+{ // result used for V0, V1, V3 and V4, three bytes per pixel in the original order
+    struct ppm_file file;
+    get_metadata(input_file, &file, width, height);
+    uint64_t span_start = trace_begin();
+    size_t number_of_pixels = (*width) * (*height);
+    uint8_t *value_of_pixels = malloc(number_of_pixels * 3); // allocate memory for input
     if (!value_of_pixels)
     {
-        exit_failure_with_errmessage_and_release(fd, NULL, "Can not allocate space for input pixels.\n");
+        exit_failure_with_errmessage_and_release(&file, "Can not allocate space for input pixels.\n");
+    }
+    if (file.magic == '6') // binary, copy the content at once
+    {
+        if (file.size - file.position < number_of_pixels * 3) // read file failed?
+        {
+            free(value_of_pixels);
+            exit_failure_with_errmessage_and_release(&file, "Read pixel values of input file failed. Is your input file deprecated?\n");
+        }
+        if (file.mapped) // unmap before reading, so the mapped file and the buffer are never resident at the same time and the peak memory is the buffer only
+        {
+            size_t payload_offset = file.position;
+            release_data(&file);
+            if (!pread_all(file.fd, value_of_pixels, number_of_pixels * 3, payload_offset))
+            {
+                free(value_of_pixels);
+                exit_failure_with_errmessage_and_release(&file, "Read pixel values of input file failed. Is your input file deprecated?\n");
+            }
+        }
+        else // the file is already in a heap buffer
+        {
+            memcpy(value_of_pixels, file.data + file.position, number_of_pixels * 3);
+        }
+    }
+    else if (file.magic == '3') // ASCII RGB, the samples are already in the right order
+    {
+        for (size_t i = 0; i < number_of_pixels * 3; ++i)
+        {
+            value_of_pixels[i] = parse_sample(&file);
+        }
     }
-    size_t success_read = fread(value_of_pixels, (*width) * (*height) * 3, 1, fd);
-    if (!success_read) // read file failed?
+    else // ASCII grey, R = G = B gives exactly the grey value after greyscale conversion
     {
-        free(value_of_pixels);
-        exit_failure_with_errmessage_and_release(fd, NULL, "Read pixel values of input file failed. Is your input file deprecated?\n");
+        for (size_t i = 0; i < number_of_pixels; ++i)
+        {
+            uint8_t grey = parse_sample(&file);
+            value_of_pixels[3 * i] = grey;
+            value_of_pixels[3 * i + 1] = grey;
+            value_of_pixels[3 * i + 2] = grey;
+        }
     }
-    fclose(fd);
+    close_input(&file);
+    trace_end("read pixels", span_start);
     return value_of_pixels;
 }
 
 void readppm_for_simd(const char *input_file, size_t *width, size_t *height, float **red_in_pixels, float **green_in_pixels, float **blue_in_pixels)
 { // result used for V2, save value of three different colors into three different buffers
-    FILE *fd = get_metadata(input_file, width, height);
+    struct ppm_file file;
+    get_metadata(input_file, &file, width, height);
+    uint64_t span_start = trace_begin();
     size_t number_of_pixels = (*width) * (*height);
     size_t color_buffer_size = ((number_of_pixels << 2) & 0xfffffffffffffff0) + 16; // size of buffer for each color, should be an integer multiple time of 16
     *red_in_pixels = aligned_alloc(16, color_buffer_size);                          // start address will then be aligned to 16
     if (!(*red_in_pixels))                                                          // allocation failed?
     {
-        exit_failure_with_errmessage_and_release(fd, NULL, "Can not allocate space for red of input pixels.\n");
+        exit_failure_with_errmessage_and_release(&file, "Can not allocate space for red of input pixels.\n");
     }
     *green_in_pixels = aligned_alloc(16, color_buffer_size);
     if (!(*green_in_pixels)) // allocation failed?
     {
         free(*red_in_pixels);
-        exit_failure_with_errmessage_and_release(fd, NULL, "Can not allocate space for green of input pixels.\n");
+        exit_failure_with_errmessage_and_release(&file, "Can not allocate space for green of input pixels.\n");
     }
     *blue_in_pixels = aligned_alloc(16, color_buffer_size);
     if (!(*blue_in_pixels)) // allocation failed?
     {
         free(*red_in_pixels);
         free(*green_in_pixels);
-        exit_failure_with_errmessage_and_release(fd, NULL, "Can not allocate space for blue of input pixels.\n");
+        exit_failure_with_errmessage_and_release(&file, "Can not allocate space for blue of input pixels.\n");
     }
-    size_t success_read = 0;
-    uint8_t integer_byte_value = 0;
-    for (size_t i = 0; i < number_of_pixels; ++i) // read the value of three colors of a pixel and save into a buffer accordingly, saving as floats
-    {
-        success_read += fread(&integer_byte_value, 1, 1, fd);
-        *((*red_in_pixels) + i) = integer_byte_value;
-        success_read += fread(&integer_byte_value, 1, 1, fd);
-        *((*green_in_pixels) + i) = integer_byte_value;
-        success_read += fread(&integer_byte_value, 1, 1, fd);
-        *((*blue_in_pixels) + i) = integer_byte_value;
-    }
-    if (success_read != 3 * number_of_pixels) // read file failed?
+    if (file.magic == '6' && file.size - file.position < number_of_pixels * 3) // read file failed?
     {
         free(*red_in_pixels);
         free(*green_in_pixels);
         free(*blue_in_pixels);
-        exit_failure_with_errmessage_and_release(fd, NULL, "Read pixel values of input file failed. Is your input file deprecated?\n");
+        exit_failure_with_errmessage_and_release(&file, "Read pixel values of input file failed. Is your input file deprecated?\n");
+    }
+    const uint8_t *content = file.data + file.position;
+    for (size_t i = 0; i < number_of_pixels; ++i) // save the value of three colors of a pixel into a buffer accordingly, saving as floats
+    {
+        if (file.magic == '6')
+        {
+            (*red_in_pixels)[i] = content[3 * i];
+            (*green_in_pixels)[i] = content[3 * i + 1];
+            (*blue_in_pixels)[i] = content[3 * i + 2];
+        }
+        else if (file.magic == '3')
+        {
+            (*red_in_pixels)[i] = parse_sample(&file);
+            (*green_in_pixels)[i] = parse_sample(&file);
+            (*blue_in_pixels)[i] = parse_sample(&file);
+        }
+        else
+        {
+            float grey = parse_sample(&file);
+            (*red_in_pixels)[i] = grey;
+            (*green_in_pixels)[i] = grey;
+            (*blue_in_pixels)[i] = grey;
+        }
     }
-    fclose(fd);
+    close_input(&file);
+    trace_end("read and deinterleave pixels", span_start);
+}
+
+size_t readppm_header_length(const char *input_file, size_t *width, size_t *height, char *magic)
+{ // used for parallel I/O, the pixel payload of the input file starts right after the header, so each thread can compute its own offset
+    struct ppm_file file;
+    get_metadata(input_file, &file, width, height);
+    *magic = file.magic;
+    close_input(&file);
+    return file.position;
 }
 
-static FILE *get_metadata(const char *input_file, size_t *width, size_t *height)
+static void open_input(const char *input_file, struct ppm_file *file)
 {
-    FILE *fd = fopen(input_file, "r");
-    if (!fd)
+    int fd = open(input_file, O_RDONLY);
+    struct stat file_status;
+    if (fd < 0 || fstat(fd, &file_status) != 0)
     {
         fprintf(stderr, "%s", "Cannot open your input file. Please check your input file.\n");
         exit(EXIT_FAILURE);
     }
-    magic_number_s0(fd);
-    magic_number_s1(fd);
-    magic_number_s2(fd); // three states to get through magic number
+    *file = (struct ppm_file){NULL, file_status.st_size, 0, true, 0, fd};
+    if (S_ISREG(file_status.st_mode) && file->size > 0)
+    {
+        void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            madvise(data, file->size, MADV_SEQUENTIAL); // the file is parsed from the start to the end
+            file->data = data;
+            return;
+        }
+    }
+    // not a regular file or mapping failed, read the whole file into a growing heap buffer
+    file->mapped = false;
+    size_t capacity = file->size > 0 ? file->size : 1 << 16;
+    uint8_t *buffer = malloc(capacity);
+    file->size = 0;
+    ssize_t success_read = 0;
+    while (buffer && (success_read = read(fd, buffer + file->size, capacity - file->size)) != 0)
+    {
+        if (success_read < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (success_read < 0)
+        {
+            break;
+        }
+        file->size += success_read;
+        if (file->size == capacity)
+        {
+            uint8_t *larger = realloc(buffer, capacity * 2);
+            if (!larger)
+            {
+                free(buffer);
+                buffer = NULL;
+                break;
+            }
+            buffer = larger;
+            capacity *= 2;
+        }
+    }
+    if (!buffer || success_read < 0)
+    {
+        free(buffer);
+        close(fd);
+        fprintf(stderr, "%s", "Cannot read your input file. Please check your input file.\n");
+        exit(EXIT_FAILURE);
+    }
+    file->data = buffer;
+}
+
+static void release_data(struct ppm_file *file)
+{
+    if (file->mapped)
+    {
+        munmap((void *)file->data, file->size);
+    }
+    else
+    {
+        free((void *)file->data);
+    }
+    file->data = NULL; // so that close_input afterwards only closes the descriptor
+    file->mapped = false;
+}
+
+static void close_input(struct ppm_file *file)
+{
+    release_data(file);
+    close(file->fd);
+}
+
+static void get_metadata(const char *input_file, struct ppm_file *file, size_t *width, size_t *height)
+{
+    uint64_t span_start = trace_begin();
+    open_input(input_file, file);
+    magic_number_s0(file);
+    magic_number_s1(file);
+    magic_number_s2(file); // three states to get through magic number
 
-    struct digits_chain *start_of_width = getsize_s0(fd);
-    getsize_s1(fd, start_of_width);                  // two states to get through width
-    *width = get_number_from_digits(start_of_width); // this will release all nodes in linked list
-    struct digits_chain *start_of_height = getsize_s0(fd);
-    getsize_s1(fd, start_of_height);                   // two states to get through height
-    *height = get_number_from_digits(start_of_height); // get number and release all nodes in linked list
-    struct digits_chain *start_of_maxval = getsize_s0(fd);
-    getsize_s1(fd, start_of_maxval);                         // two states to get through maxval
-    size_t maxval = get_number_from_digits(start_of_maxval); // get number and release all nodes in linked list
-    if (maxval != 255)                                       // check if is picture is 24bpp
+    *width = getsize_s1(file, getsize_s0(file));          // two states to get through width
+    *height = getsize_s1(file, getsize_s0(file));         // two states to get through height
+    size_t maxval = getsize_s1(file, getsize_s0(file));   // two states to get through maxval
+    if (maxval != 255)                                    // check if is picture is 24bpp
     {
-        exit_failure_with_errmessage_and_release(fd, NULL, "This program only accept 24 bpp pictures, which means the maxval of your picture has to be 255. However, the maxval in the given picture is %lu.\n");
+        char err_msg[256];
+        snprintf(err_msg, sizeof(err_msg), "This program only accept 24 bpp pictures, which means the maxval of your picture has to be 255. However, the maxval in the given picture is %lu.\n", maxval);
+        exit_failure_with_errmessage_and_release(file, err_msg);
     }
-    if (width == 0 || height == 0) // check if width or height in input file is 0
+    if (*width == 0 || *height == 0) // check if width or height in input file is 0
     {
-        exit_failure_with_errmessage_and_release(fd, NULL, "Width or height in the metadata of the input file is 0.\n");
+        exit_failure_with_errmessage_and_release(file, "Width or height in the metadata of the input file is 0.\n");
     }
-    return fd;
+    trace_end("get_metadata", span_start);
 }
 
-static void magic_number_s0(FILE *fd)
+static int next_char(struct ppm_file *file)
+{
+    return file->position < file->size ? file->data[file->position++] : EOF;
+}
+
+static void magic_number_s0(struct ppm_file *file)
 {
     while (true)
     {
-        switch (fgetc(fd))
+        switch (next_char(file))
         {
         case 'P': // exit this state, found P of'P6'
             return;
         case '#': // encountered a comment
-            enter_and_exit_comment_with_errorfree(fd, NULL);
+            enter_and_exit_comment_with_errorfree(file);
             break;
         default: // unallowed character at this state showed up
-            exit_failure_with_errmessage_and_release(fd, NULL, "Magic number not starting with P. Please check your input file.\n");
+            exit_failure_with_errmessage_and_release(file, "Magic number not starting with P. Please check your input file.\n");
         }
     }
 }
 
-static void magic_number_s1(FILE *fd)
+static void magic_number_s1(struct ppm_file *file)
 {
     while (true)
     {
-        switch (fgetc(fd))
+        int tmp = next_char(file);
+        switch (tmp)
         {
-        case '6': // exit this state, found 6 of 'P6'
+        case '6': // exit this state, found 6 of 'P6', 3 of 'P3' or 2 of 'P2'
+        case '3':
+        case '2':
+            file->magic = tmp;
             return;
         case '#': // encountered a comment
-            enter_and_exit_comment_with_errorfree(fd, NULL);
+            enter_and_exit_comment_with_errorfree(file);
             break;
         default: // unallowed char at this state showed up
-            exit_failure_with_errmessage_and_release(fd, NULL, "Second digit of Magic number is not 6. Please check your input file.\n");
+            exit_failure_with_errmessage_and_release(file, "Second digit of Magic number is not 6, 3 or 2. Please check your input file.\n");
         }
     }
 }
 
-static void magic_number_s2(FILE *fd)
+static void magic_number_s2(struct ppm_file *file)
 {
-    int tmp = -1;
     while (true)
     {
-        tmp = fgetc(fd);
+        int tmp = next_char(file);
         if (tmp == '#') // encountered a comment
         {
-            enter_and_exit_comment_with_errorfree(fd, NULL);
+            enter_and_exit_comment_with_errorfree(file);
         }
         else if (isspace(tmp)) // found whitespace after 'P6', exit the state
         {
@@ -164,123 +314,154 @@ static void magic_number_s2(FILE *fd)
         }
         else // unallowed char at this state showed up
         {
-            exit_failure_with_errmessage_and_release(fd, NULL, "Magic number has more than two digits. Please check your input file.\n");
+            exit_failure_with_errmessage_and_release(file, "Magic number has more than two digits. Please check your input file.\n");
         }
     }
 }
 
-static void enter_and_exit_comment_with_errorfree(FILE *fd, struct digits_chain *start)
+static void enter_and_exit_comment_with_errorfree(struct ppm_file *file)
 {
-    int tmp = -1;
     while (true)
     {
-        tmp = fgetc(fd);
+        int tmp = next_char(file);
         if (tmp == 10 || tmp == 13) // found a CR or LF
         {
             break;
         }
         if (tmp == EOF) // found EOF in a comment
         {
-            exit_failure_with_errmessage_and_release(fd, start, "It seems that your input file ends in a comment. This is weird. Please check your input file.\n");
+            exit_failure_with_errmessage_and_release(file, "It seems that your input file ends in a comment. This is weird. Please check your input file.\n");
         }
     }
 }
 
-static struct digits_chain *getsize_s0(FILE *fd) // start reading a number in ASCII, return the head of a linked list
+static size_t getsize_s0(struct ppm_file *file) // start reading a number in ASCII, return the value of its first digit
 {
     while (true)
     {
-        int tmp = fgetc(fd);
+        int tmp = next_char(file);
         if (isspace(tmp)) // escape whitespaces between metadata, remain this state
         {
             continue;
         }
         else if (tmp == '#') // encountered a comment
         {
-            enter_and_exit_comment_with_errorfree(fd, NULL);
+            enter_and_exit_comment_with_errorfree(file);
         }
-        else if (tmp >= 48 && tmp <= 57) // found a digit in ASCII, remain this state
+        else if (tmp >= 48 && tmp <= 57) // found a digit in ASCII, exit this state
         {
-            struct digits_chain *start = malloc(sizeof(struct digits_chain)); // allocate memory for list head
-            if (start == NULL)
-            {
-                exit_failure_with_errmessage_and_release(fd, NULL, "space allocation failed.\n");
-            }
-            start->digit = tmp;
-            start->next = NULL;
-            return start;
+            return tmp - 48;
         }
         else // unallowed char at this state showed up
         {
-            exit_failure_with_errmessage_and_release(fd, NULL, "The width or height or maxval info in your file is not starting with a digit. Please check your input file.\n");
+            exit_failure_with_errmessage_and_release(file, "The width or height or maxval info in your file is not starting with a digit. Please check your input file.\n");
         }
     }
 }
 
-static void getsize_s1(FILE *fd, struct digits_chain *start)
+static size_t getsize_s1(struct ppm_file *file, size_t value)
 {
-    struct digits_chain *current = start;
     while (true)
     {
-        int tmp = fgetc(fd);
+        int tmp = next_char(file);
         if (isspace(tmp)) // found whitespace, exit the state
         {
-            return;
+            return value;
         }
         else if (tmp == '#') // encountered a comment
         {
-            enter_and_exit_comment_with_errorfree(fd, start);
+            enter_and_exit_comment_with_errorfree(file);
         }
         else if (tmp >= 48 && tmp <= 57) // found a digit in ASCII, remain this state
         {
-            current->next = malloc(sizeof(struct digits_chain));
-            if (current->next == NULL) // if allocation failed, then release all allocated memory and close input file
+            if (value > (SIZE_MAX - 9) / 10) // the number doesn't fit into size_t
             {
-                exit_failure_with_errmessage_and_release(fd, start, "space allocation failed.\n");
+                exit_failure_with_errmessage_and_release(file, "The width or height or maxval info in your file is too large. Please check your input file.\n");
             }
-            current = current->next;
-            current->digit = tmp;
-            current->next = NULL;
+            value = value * 10 + tmp - 48;
         }
         else // unallowed char at this state showed up
         {
-            exit_failure_with_errmessage_and_release(fd, start, "The width or height or maxval info in your file contains non digits. Please check your input file.\n");
+            exit_failure_with_errmessage_and_release(file, "The width or height or maxval info in your file contains non digits. Please check your input file.\n");
         }
     }
 }
 
-static size_t get_number_from_digits(struct digits_chain *start) // parse a linked list of ascii digits to a number, and free this list
+static void skip_separators(struct ppm_file *file)
 {
-    size_t ret = 0;
-    struct digits_chain *tofree = NULL;
-    while (start)
+    while (file->position < file->size)
     {
-        ret = ret * 10 + start->digit - 48;
-        tofree = start;
-        start = start->next;
-        free(tofree);
+        uint8_t tmp = file->data[file->position];
+        if (isspace(tmp)) // CR, LF, blank lines and several spaces are allowed between samples
+        {
+            ++file->position;
+        }
+        else if (tmp == '#') // a comment runs until the end of the line
+        {
+            ++file->position;
+            enter_and_exit_comment_with_errorfree(file);
+        }
+        else
+        {
+            return;
+        }
     }
-    return ret;
 }
 
-static void free_from_start(struct digits_chain *start) // free linked list with head of list
+static uint8_t parse_sample(struct ppm_file *file)
 {
-    struct digits_chain *tofree = NULL;
-    while (start)
+    skip_separators(file); // only one whitespace after maxval is consumed by get_metadata, because binary pixels start right after it
+    const uint8_t *ptr = file->data + file->position;
+    size_t remaining = file->size - file->position;
+    uint64_t value = 0;
+    size_t length = 0; // number of digits
+    if (remaining >= 8) // load eight characters at once and find the digits with SWAR
+    {
+        uint64_t chunk;
+        memcpy(&chunk, ptr, 8); // little endian, the first character is in the lowest byte
+        // a byte is a digit iff its high nibble is 3 and adding 6 doesn't change the high nibble, a carry can only come from a non digit byte below
+        uint64_t non_digit = ((chunk & 0xF0 * SWAR_ONES) ^ 0x30 * SWAR_ONES) | (((chunk + 0x06 * SWAR_ONES) & 0xF0 * SWAR_ONES) ^ 0x30 * SWAR_ONES);
+        non_digit = ((non_digit & 0x7F * SWAR_ONES) + 0x7F * SWAR_ONES) | non_digit; // the high bit of every non digit byte is set
+        non_digit &= 0x80 * SWAR_ONES;
+        length = non_digit ? __builtin_ctzll(non_digit) / 8 : 8;
+        if (length > 0 && length < 8)
+        {
+            uint64_t digits = (chunk ^ 0x30 * SWAR_ONES) << (8 * (8 - length)); // move the digits to the top, the zero bytes below are leading zeros
+            digits = ((digits & 0x0F * SWAR_ONES) * (1 + (10 << 8))) >> 8;                     // combine neighbouring digits into numbers below 100
+            digits = ((digits & 0x00FF00FF00FF00FFull) * (1 + (100 << 16))) >> 16;           // below 10000
+            value = ((digits & 0x0000FFFF0000FFFFull) * (1 + (10000ull << 32))) >> 32;        // all eight digits
+        }
+    }
+    if (remaining < 8 || length == 8) // close to the end of the file or no separator in the eight characters, e.g. leading zeros, parse character by character
     {
-        tofree = start;
-        start = start->next;
-        free(tofree);
+        value = 0;
+        length = 0;
+        while (length < remaining && ptr[length] >= 48 && ptr[length] <= 57 && value <= 255) // stop once the value is too large, so that it can't overflow
+        {
+            value = value * 10 + ptr[length] - 48;
+            ++length;
+        }
+    }
+    if (length == 0)
+    {
+        exit_failure_with_errmessage_and_release(file, "Missing or invalid pixel value in your input file. Please check your input file.\n");
+    }
+    if (value > 255)
+    {
+        exit_failure_with_errmessage_and_release(file, "A pixel value in your input file exceeds the maxval. Please check your input file.\n");
     }
+    file->position += length;
+    if (file->position < file->size && !isspace(file->data[file->position]) && file->data[file->position] != '#') // samples have to be separated by whitespace or a comment
+    {
+        exit_failure_with_errmessage_and_release(file, "Missing or invalid pixel value in your input file. Please check your input file.\n");
+    }
+    return value;
 }
 
-static void exit_failure_with_errmessage_and_release(FILE *fd, struct digits_chain *start, const char *err_msg) // error exit after releasing resources and an error feedback, if start points to start of digit chain, then release the chain, otherwise only close the file
+static void exit_failure_with_errmessage_and_release(struct ppm_file *file, const char *err_msg) // error exit after releasing the input file and an error feedback
 {
     fprintf(stderr, "%s", err_msg);
-    fclose(fd);
-    if (start)
-    {
-        free_from_start(start);
-    }
+    close_input(file);
     exit(EXIT_FAILURE);
-}
\ No newline at end of file
+}
+
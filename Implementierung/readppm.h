@@ -3,9 +3,17 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
 
 #ifndef READPPM_H
 #define READPPM_H
 uint8_t *readppm_for_seq(const char *input_file, size_t * width, size_t * height);
 void readppm_for_simd(const char * input_file, size_t *width, size_t *height, float ** red_in_pixels, float ** green_in_pixels, float ** blue_in_pixels);
+size_t readppm_header_length(const char *input_file, size_t *width, size_t *height, char *magic); // magic is set to '6', '3' or '2' for P6, P3 or P2
 #endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "trace.h"
+#define MAX_SPANS 65536 // spans beyond this limit are dropped, e.g. during long benchmarks
+
+struct span // one complete event ("ph":"X") in Chrome trace-event format
+{
+    const char *name;
+    uint64_t start; // in nanoseconds
+    uint64_t end;   // in nanoseconds
+    int tid;
+};
+
+static _Bool enabled = false;                  // is tracing enabled? only written once before any thread is started
+static const char *output_file = NULL;         // file the spans are written to at exit
+static struct span spans[MAX_SPANS];           // recorded spans, filled by all threads
+static atomic_size_t number_of_spans = 0;      // next free slot in spans, may grow beyond MAX_SPANS if spans are dropped
+static atomic_int next_tid = 0;                // thread ids are assigned in the order threads record their first span
+static _Thread_local int tid = -1;             // id of the calling thread, -1 if not assigned yet
+
+static void write_trace(void); // registered with atexit, so that the trace is also written if the program terminates with an error
+
+void trace_enable(const char *trace_file)
+{
+    output_file = trace_file;
+    enabled = true;
+    atexit(write_trace);
+}
+
+uint64_t trace_clock(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+uint64_t trace_begin(void)
+{
+    return enabled ? trace_clock() : 0;
+}
+
+void trace_end(const char *name, uint64_t start)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    uint64_t end = trace_clock();
+    if (tid < 0)
+    {
+        tid = atomic_fetch_add(&next_tid, 1);
+    }
+    size_t index = atomic_fetch_add(&number_of_spans, 1);
+    if (index < MAX_SPANS)
+    {
+        spans[index] = (struct span){name, start, end, tid};
+    }
+}
+
+static void write_trace(void)
+{
+    FILE *fd = fopen(output_file, "w");
+    if (!fd)
+    {
+        fprintf(stderr, "Cannot open trace file.\n");
+        return;
+    }
+    size_t recorded = atomic_load(&number_of_spans);
+    if (recorded > MAX_SPANS)
+    {
+        fprintf(stderr, "Trace is full, %lu spans are dropped.\n", recorded - MAX_SPANS);
+        recorded = MAX_SPANS;
+    }
+    fprintf(fd, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < recorded; ++i) // timestamps in trace-event format are microseconds
+    {
+        fprintf(fd, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}%s\n", spans[i].name, spans[i].start / 1e3, (spans[i].end - spans[i].start) / 1e3, spans[i].tid, i + 1 < recorded ? "," : "");
+    }
+    fprintf(fd, "],\"displayTimeUnit\":\"ns\"}\n");
+    if (fclose(fd) != 0)
+    {
+        fprintf(stderr, "Failed to write into trace file.\n");
+    }
+}
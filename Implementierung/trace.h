@@ -0,0 +1,14 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#ifndef TRACE_H
+#define TRACE_H
+void trace_enable(const char *trace_file);         // start recording spans, they are written to trace_file in Chrome trace-event format when the program exits
+uint64_t trace_clock(void);                        // monotonic time in nanoseconds, also available when tracing is disabled
+uint64_t trace_begin(void);                        // start of a span, returns 0 without reading the clock if tracing is disabled
+void trace_end(const char *name, uint64_t start);  // record the span from start until now, name has to be a string literal
+#endif
@@ -0,0 +1,228 @@
+#include "tune.h"
+#define SAMPLE_PIXELS (1 << 18) // the candidates are measured on at most this many pixels from the middle of the input
+#define MIN_MEASURE_TIME 0.05   // every candidate is repeated until it ran at least this many seconds
+#define MAX_LINE 512            // max length of a line in the wisdom file
+
+struct tune_job // rows of the sample handled by one thread during a measurement
+{
+    seq_kernel kernel;
+    const uint8_t *input;
+    uint8_t *output;
+    size_t width;
+    size_t rows;
+    size_t block_rows;
+    float a, b, c, gamma;
+    _Bool failed;
+};
+
+static double measure(struct tuning, const uint8_t *, uint8_t *, size_t, size_t, float, float, float, float); // seconds per run of the candidate on the sample, negative if it failed
+static _Bool run_candidate(struct tuning, const uint8_t *, uint8_t *, size_t, size_t, float, float, float, float);
+static void *run_job(void *);
+static void wisdom_key(char *, size_t, size_t, size_t, float, _Bool); // host name, number of cores, size class, gamma class and use of the V4 cache
+
+struct tuning tune(const char *input_file, float a, float b, float c, float gamma, _Bool with_lut)
+{
+    size_t width, height;
+    uint8_t *input = readppm_for_seq(input_file, &width, &height);
+    size_t sample_rows = SAMPLE_PIXELS / width ? SAMPLE_PIXELS / width : 1; // at least one row
+    if (sample_rows > height)
+    {
+        sample_rows = height;
+    }
+    const uint8_t *sample = input + (height - sample_rows) / 2 * width * 3; // the middle of an image is more representative than the borders
+    uint8_t *output = malloc(width * sample_rows);
+    if (!output)
+    {
+        free(input);
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    long online_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = online_cores > 0 ? online_cores : 1;
+    size_t thread_counts[8 * sizeof(size_t) + 1]; // 1, 2, 4, ... and the number of cores
+    size_t number_of_thread_counts = 0;
+    for (size_t threads = 1; threads < max_threads; threads *= 2)
+    {
+        thread_counts[number_of_thread_counts++] = threads;
+    }
+    thread_counts[number_of_thread_counts++] = max_threads;
+    static const int versions[] = {0, 1, 2, 3, 4};
+    static const size_t blocks[] = {0, 16, 64, 256};
+    struct tuning best = {0, 1, 0};
+    double best_time = -1;
+    for (size_t v = 0; v < sizeof(versions) / sizeof(versions[0]); ++v)
+    {
+        if (versions[v] == 4 && !with_lut) // without a persisted table every run of V4 would have to build it
+        {
+            continue;
+        }
+        for (size_t t = 0; t < number_of_thread_counts; ++t)
+        {
+            size_t threads = thread_counts[t];
+            for (size_t k = 0; k < sizeof(blocks) / sizeof(blocks[0]); ++k)
+            {
+                if (blocks[k] * threads >= sample_rows) // the block would contain the whole rows of a thread, same as block size 0
+                {
+                    continue;
+                }
+                struct tuning candidate = {versions[v], threads, blocks[k]};
+                double time = measure(candidate, sample, output, width, sample_rows, a, b, c, gamma);
+                if (time < 0)
+                {
+                    continue;
+                }
+                printf("version %d, %lu threads, block rows %lu: %lfs per megapixel\n", candidate.version, candidate.number_of_threads, candidate.block_rows, time * 1e6 / (width * sample_rows));
+                if (best_time < 0 || time < best_time)
+                {
+                    best = candidate;
+                    best_time = time;
+                }
+            }
+        }
+    }
+    free(input);
+    free(output);
+    printf("Fastest is version %d with %lu threads and block rows %lu.\n", best.version, best.number_of_threads, best.block_rows);
+    return best;
+}
+
+static double measure(struct tuning candidate, const uint8_t *sample, uint8_t *output, size_t width, size_t rows, float a, float b, float c, float gamma)
+{
+    if (!run_candidate(candidate, sample, output, width, rows, a, b, c, gamma)) // warm up, this also builds or maps the table of V4
+    {
+        return -1;
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    double time = 0;
+    size_t repetitions = 0;
+    while (time < MIN_MEASURE_TIME)
+    {
+        run_candidate(candidate, sample, output, width, rows, a, b, c, gamma);
+        ++repetitions;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+    }
+    return time / repetitions;
+}
+
+static _Bool run_candidate(struct tuning candidate, const uint8_t *sample, uint8_t *output, size_t width, size_t rows, float a, float b, float c, float gamma)
+{ // split the rows like gamma_correct_parallel_io, but in memory, so that disk speed doesn't distort the result
+    struct tune_job jobs[candidate.number_of_threads];
+    pthread_t threads[candidate.number_of_threads];
+    size_t first_row = 0;
+    for (size_t i = 0; i < candidate.number_of_threads; ++i)
+    {
+        size_t job_rows = rows / candidate.number_of_threads + (i < rows % candidate.number_of_threads);
+        jobs[i] = (struct tune_job){kernel_of_version(candidate.version), sample + first_row * width * 3, output + first_row * width, width, job_rows, candidate.block_rows, a, b, c, gamma, false};
+        first_row += job_rows;
+    }
+    size_t started_threads = 0;
+    for (size_t i = 1; i < candidate.number_of_threads; ++i) // the first job runs on the calling thread
+    {
+        if (pthread_create(&threads[i], NULL, run_job, &jobs[i]) != 0)
+        {
+            jobs[i].failed = true;
+            break;
+        }
+        ++started_threads;
+    }
+    run_job(&jobs[0]);
+    _Bool success = !jobs[0].failed;
+    for (size_t i = 1; i <= started_threads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        success = success && !jobs[i].failed;
+    }
+    return success && started_threads + 1 == candidate.number_of_threads;
+}
+
+static void *run_job(void *arg)
+{
+    struct tune_job *job = arg;
+    size_t rows_per_block = job->block_rows && job->block_rows < job->rows ? job->block_rows : job->rows;
+    for (size_t row = 0; row < job->rows && !job->failed; row += rows_per_block)
+    {
+        size_t rows = job->rows - row < rows_per_block ? job->rows - row : rows_per_block;
+        job->failed = !transform_rows(job->kernel, job->input + row * job->width * 3, job->width, rows, job->a, job->b, job->c, job->gamma, job->output + row * job->width);
+    }
+    return NULL;
+}
+
+static void wisdom_key(char *key, size_t key_size, size_t width, size_t height, float gamma, _Bool with_lut)
+{
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    for (char *ptr = host; *ptr; ++ptr) // the key is separated by spaces in the wisdom file
+    {
+        if (*ptr == ' ')
+        {
+            *ptr = '_';
+        }
+    }
+    unsigned size_class = 0; // log2 of the number of pixels, images of similar size behave the same
+    for (size_t pixels = width * height; pixels > 1; pixels >>= 1)
+    {
+        ++size_class;
+    }
+    // V1 skips the taylor expansion for integer gammas, so integer and fractional gammas are tuned separately
+    // V4 is only fast if its table is mapped from the cache, so runs with and without option lut-cache are tuned separately
+    snprintf(key, key_size, "%s %ld %u %s %s", host, sysconf(_SC_NPROCESSORS_ONLN), size_class, gamma == floorf(gamma) ? "integer" : "fraction", with_lut ? "lut" : "nolut");
+}
+
+_Bool wisdom_lookup(const char *wisdom_file, size_t width, size_t height, float gamma, _Bool with_lut, struct tuning *tuning)
+{
+    FILE *fd = fopen(wisdom_file, "r");
+    if (!fd)
+    {
+        return false;
+    }
+    char key[MAX_LINE];
+    wisdom_key(key, sizeof(key), width, height, gamma, with_lut);
+    size_t key_length = strlen(key);
+    char line[MAX_LINE];
+    _Bool found = false;
+    while (!found && fgets(line, sizeof(line), fd))
+    {
+        // every line is "<host> <cores> <size class> <gamma class> <lut class> <version> <threads> <block rows>"
+        found = strncmp(line, key, key_length) == 0 && line[key_length] == ' ' && sscanf(line + key_length, "%d %lu %lu", &tuning->version, &tuning->number_of_threads, &tuning->block_rows) == 3;
+    }
+    fclose(fd);
+    return found && tuning->version >= 0 && tuning->version <= 4 && (tuning->version != 4 || with_lut) && tuning->number_of_threads >= 1; // an edited file must not choose V4 without a cache either
+}
+
+_Bool wisdom_store(const char *wisdom_file, size_t width, size_t height, float gamma, _Bool with_lut, struct tuning tuning)
+{
+    char key[MAX_LINE];
+    wisdom_key(key, sizeof(key), width, height, gamma, with_lut);
+    size_t key_length = strlen(key);
+    char tmp_file[4096];
+    snprintf(tmp_file, sizeof(tmp_file), "%s.%ld.tmp", wisdom_file, (long)getpid()); // write to a temporary file and rename it, so concurrent runs never read a partial file
+    FILE *out = fopen(tmp_file, "w");
+    if (!out)
+    {
+        return false;
+    }
+    FILE *in = fopen(wisdom_file, "r");
+    char line[MAX_LINE];
+    _Bool success = true;
+    while (in && fgets(line, sizeof(line), in)) // keep the entries of other hosts and image shapes
+    {
+        if (!(strncmp(line, key, key_length) == 0 && line[key_length] == ' '))
+        {
+            success = success && fputs(line, out) >= 0;
+        }
+    }
+    if (in)
+    {
+        fclose(in);
+    }
+    success = success && fprintf(out, "%s %d %lu %lu\n", key, tuning.version, tuning.number_of_threads, tuning.block_rows) >= 0;
+    success = fclose(out) == 0 && success;
+    if (!success || rename(tmp_file, wisdom_file) != 0)
+    {
+        unlink(tmp_file);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,24 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "parallelio.h"
+#include "readppm.h"
+
+#ifndef TUNE_H
+#define TUNE_H
+struct tuning // what the autotuner chooses, block_rows 0 means every thread handles its rows at once
+{
+    int version;
+    size_t number_of_threads;
+    size_t block_rows;
+};
+struct tuning tune(const char *input_file, float a, float b, float c, float gamma, _Bool with_lut);                       // benchmark all candidates on a sample of the input and return the fastest, V4 is only a candidate if with_lut is set
+_Bool wisdom_lookup(const char *wisdom_file, size_t width, size_t height, float gamma, _Bool with_lut, struct tuning *tuning); // returns false if the wisdom file has no entry for this host, image shape and use of the V4 cache
+_Bool wisdom_store(const char *wisdom_file, size_t width, size_t height, float gamma, _Bool with_lut, struct tuning tuning);   // replace or add the entry for this host, image shape and use of the V4 cache
+#endif